@@ -0,0 +1,90 @@
+#
+# Tile and collision mask reading, shared by the converters.
+#
+# (c) Copyright 2011 Steve Maddison
+#
+# read_tiles( file ) - Tiles from a gconvert output file, each a reference
+#                      to its 64 pixel bytes.
+# read_col( file )   - Quadrant masks from the ".col" file which goes with
+#                      a gconvert output file, one per tile.
+# fine_mask( data, col, clear )
+#                    - A tile's mask of 2x2 pixel cells for COL_FINE
+#                      builds. A cell is solid if it lies in a solid
+#                      quadrant and isn't all the clear colour. The
+#                      top-left one is in the most significant bit.
+#
+
+package TileData;
+
+use strict;
+use Exporter;
+
+our @ISA = ( 'Exporter' );
+our @EXPORT = ( 'read_tiles', 'read_col', 'fine_mask' );
+
+sub read_tiles {
+	my ( $file ) = @_;
+	my @tiles = ();
+	my @bytes = ();
+
+	open( my $fh, '<', $file ) || die "$file: $!\n";
+	my $in_array = 0;
+	while( my $line = <$fh> ) {
+		if( $line =~ /PROGMEM\s*=\s*\{/ ) {
+			$in_array = 1;
+			$line =~ s/^.*\{//;
+		}
+		next if( !$in_array );
+		$line =~ s/\/\/.*$//;
+		while( $line =~ /(0x[0-9a-fA-F]+|\d+)/g ) {
+			my $v = $1;
+			push( @bytes, $v =~ /^0x/ ? hex($v) : $v );
+		}
+		last if( $line =~ /\}/ );
+	}
+	close( $fh );
+
+	if( @bytes % 64 ) {
+		die "$file: tile data is not a multiple of 64 bytes\n";
+	}
+	while( @bytes ) {
+		push( @tiles, [ splice( @bytes, 0, 64 ) ] );
+	}
+	return @tiles;
+}
+
+sub read_col {
+	my ( $file ) = @_;
+	my @col = ();
+
+	$file =~ s/\.inc$/.col/;
+	open( my $fh, '<', $file ) || die "$file: $!\n";
+	while( my $line = <$fh> ) {
+		$line =~ s/#.*$//;
+		while( $line =~ /([0-9a-fA-F]{2})/g ) {
+			push( @col, hex($1) );
+		}
+	}
+	close( $fh );
+	return @col;
+}
+
+sub fine_mask {
+	my ( $data, $col, $clear ) = @_;
+	my $mask = 0;
+
+	for( my $cy = 0 ; $cy < 4 ; $cy++ ) {
+		for( my $cx = 0 ; $cx < 4 ; $cx++ ) {
+			my $q = $cy < 2 ? ( $cx < 2 ? 8 : 4 ) : ( $cx < 2 ? 2 : 1 );
+			next if( !($col & $q) );
+			my $p = ($cy*16) + ($cx*2);
+			if( $data->[$p] != $clear || $data->[$p+1] != $clear
+			||  $data->[$p+8] != $clear || $data->[$p+9] != $clear ) {
+				$mask |= 0x8000 >> (($cy*4) + $cx);
+			}
+		}
+	}
+	return $mask;
+}
+
+1;
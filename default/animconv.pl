@@ -0,0 +1,208 @@
+#!/usr/bin/perl -w
+
+#
+# Enemy animation conversion, with precalculated frame deltas.
+#
+# (c) Copyright 2011 Steve Maddison
+#
+# Input:      Plain text file describing the frames of each animation
+#             (see data/anims.txt for the format).
+# Processing: Builds the usual width/height prefixed map for every frame
+#             and, for each transition between frames, a list of only the
+#             cells which change. Moving from the last frame back to the
+#             first is included, as are any transitions listed with a move.
+# Output:     C source file containing the maps, the delta lists, a
+#             delta_id_t enumeration and the anim_deltas[] table, with one
+#             entry per tile set.
+#
+
+use strict;
+
+my @anims = ();
+my $anim;
+my $frame;
+
+my $name = $ARGV[0] || '';
+
+if( $name eq '' ) {
+	die "No file name provided\n";
+}
+
+$name =~ s/^.*\///;
+$name =~ s/\..*$//;
+
+# Read in the whole file;
+while( my $line = <> ) {
+	$line =~ s/#.*$//;
+	next if( $line =~ /^\s*$/ );
+
+	if( $line =~ /^anim\s+(\w+)\s+(\d+)\s+(\d+)\s*(\w*)/ ) {
+		$anim = {
+			name   => $1,
+			width  => $2,
+			height => $3,
+			sets   => $4 || 'tiles1',
+			frames => [],
+			moves  => []
+		};
+		if( $anim->{width} > 15 || $anim->{height} > 15 ) {
+			die "$anim->{name}: too big\n";
+		}
+		push( @anims, $anim );
+	}
+	elsif( $line =~ /^frame/ ) {
+		die "Frame outside of animation\n" if( !defined $anim );
+		$frame = [];
+		push( @{ $anim->{frames} }, $frame );
+	}
+	elsif( $line =~ /^delta\s+(\d+)\s+(\d+)\s+(-?\d+)\s+(-?\d+)/ ) {
+		die "Delta outside of animation\n" if( !defined $anim );
+		if( $3 > 0 || $4 > 0 ) {
+			die "$anim->{name}: only moves left/up are supported\n";
+		}
+		push( @{ $anim->{moves} }, [ $1, $2, $3, $4 ] );
+	}
+	elsif( $line =~ /^shift\s/ ) {
+		# Pre-shifted frames are built along with the tiles, by tilemerge.pl.
+	}
+	elsif( $line =~ /^\s+[\d\s]+$/ ) {
+		die "Tiles outside of frame\n" if( !defined $frame );
+		my @row = split( ' ', $line );
+		if( @row != $anim->{width} ) {
+			die "$anim->{name}: row should have $anim->{width} tiles\n";
+		}
+		push( @$frame, @row );
+	}
+	else {
+		die "Unrecognised line: $line";
+	}
+}
+
+print "//\n";
+print "// Generated animation data for '$name'\n";
+print "//\n";
+print "\n";
+
+my @delta_ids = ();
+my @delta_vars = ();
+my $full_bytes = 0;
+my $delta_bytes = 0;
+
+foreach my $a ( @anims ) {
+	my $w = $a->{width};
+	my $h = $a->{height};
+	my $frames = scalar( @{ $a->{frames} } );
+	my @sets = set_list( $a->{sets} );
+	my $dim = $a->{sets} eq 'both' ? "[2]" : "";
+
+	foreach my $f ( @{ $a->{frames} } ) {
+		if( @$f != $w*$h ) {
+			die "$a->{name}: frame should have ", $w*$h, " tiles\n";
+		}
+	}
+
+	# Full maps
+	print "const char $a->{name}_map${dim}[$frames][", $w*$h+2, "] PROGMEM = {\n";
+	foreach my $set ( @sets ) {
+		print "\t{\n" if( $dim );
+		for( my $i = 0 ; $i < $frames ; $i++ ) {
+			my @t = map { tile( $set, $_ ) } @{ $a->{frames}[$i] };
+			print "\t" if( $dim );
+			print "\t{ $w,$h,\t", join( ', ', @t ), " }", ( $i < $frames-1 ? "," : "" ), "\n";
+		}
+		if( $dim ) {
+			print "\t}", ( $set ne $sets[-1] ? "," : "" ), "\n";
+		}
+	}
+	print "};\n";
+	$full_bytes += $frames * $w * $h;
+
+	# Deltas: each consecutive frame, looping back to the start, plus moves.
+	my @transitions = ();
+	for( my $i = 0 ; $i < $frames && $frames > 1 ; $i++ ) {
+		push( @transitions, [ $i, ($i+1) % $frames, 0, 0 ] );
+	}
+	push( @transitions, @{ $a->{moves} } );
+
+	foreach my $tr ( @transitions ) {
+		my ( $from, $to, $dx, $dy ) = @$tr;
+		if( $from >= $frames || $to >= $frames ) {
+			die "$a->{name}: no such frame in delta $from -> $to\n";
+		}
+		my $old = $a->{frames}[$from];
+		my $new = $a->{frames}[$to];
+		my @cells = ();
+
+		# Cells are relative to the new position, the old frame being
+		# offset by the move. Cells no longer covered are blanked.
+		for( my $y = 0 ; $y < $h-$dy ; $y++ ) {
+			for( my $x = 0 ; $x < $w-$dx ; $x++ ) {
+				my $ox = $x + $dx;
+				my $oy = $y + $dy;
+				my $o = ( $ox >= 0 && $ox < $w && $oy >= 0 && $oy < $h ) ? $old->[$oy*$w+$ox] : 0;
+				my $n = ( $x < $w && $y < $h ) ? $new->[$y*$w+$x] : 0;
+				if( $o != $n ) {
+					push( @cells, [ ($y<<4)|$x, $n ] );
+				}
+			}
+		}
+
+		my $suffix = "${from}_${to}";
+		$suffix .= "_up" if( $dy );
+		$suffix .= "_left" if( $dx );
+		my $var = "$a->{name}_delta_$suffix";
+		push( @delta_ids, uc("DELTA_$a->{name}_$suffix") );
+
+		print "const unsigned char ${var}${dim}[", scalar(@cells)*2+1, "] PROGMEM = {\n";
+		foreach my $set ( @sets ) {
+			print "\t", ( $dim ? "{ " : "" ), scalar(@cells);
+			foreach my $c ( @cells ) {
+				printf ",  0x%02x,%s", $c->[0], tile( $set, $c->[1] );
+			}
+			print " }" if( $dim );
+			print "," if( $dim && $set ne $sets[-1] );
+			print "\n";
+		}
+		print "};\n";
+
+		if( $dim ) {
+			push( @delta_vars, [ "${var}[0]", "${var}[1]" ] );
+		}
+		else {
+			push( @delta_vars, [ $var, $var ] );
+		}
+		$delta_bytes += scalar(@cells);
+	}
+	print "\n";
+}
+
+print "typedef enum {\n";
+foreach my $id ( @delta_ids ) {
+	print "\t$id,\n";
+}
+print "\tDELTA_COUNT\n";
+print "} delta_id_t;\n";
+print "\n";
+
+print "const unsigned char * const anim_deltas[DELTA_COUNT][2] PROGMEM = {\n";
+for( my $i = 0 ; $i < @delta_vars ; $i++ ) {
+	print "\t{ $delta_vars[$i][0], $delta_vars[$i][1] }", ( $i < $#delta_vars ? "," : "" ), "\n";
+}
+print "};\n";
+print "\n";
+
+print "// STATISTICS:\n";
+print "// Tiles in full frames = $full_bytes\n";
+print "// Tiles in deltas      = $delta_bytes\n";
+print "\n";
+
+sub set_list {
+	my ( $sets ) = @_;
+	return ( 'tiles1', 'tiles2' ) if( $sets eq 'both' );
+	return ( $sets );
+}
+
+sub tile {
+	my ( $set, $t ) = @_;
+	return ( $set eq 'tiles2' && $t != 0 ) ? "TILE2($t)" : $t;
+}
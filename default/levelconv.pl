@@ -7,6 +7,8 @@
 # 
 # Input:      Plain text file containing map drawn in ASCII art.
 #             Lines must be prefixed with digits (i.e. line numbers).
+#             Optionally, "-r file" names a tile remap file from
+#             tilemerge.pl to translate the tile numbers through.
 # Processing: Encodes the data into columns, replacing subsequent
 #             occurrences of the same character with a meta-char
 #             followed by a count. Also encodes identical subsequent
@@ -16,6 +18,7 @@
 #
 
 use strict;
+use Getopt::Std;
 
 # Map ASCII characters in the input to tile numbers in the output.
 my %charmap = (
@@ -93,6 +96,20 @@ my $height = 0;
 my @rowdata;
 my $bytes = 0;
 
+# Optional tile remap file, as written by tilemerge.pl.
+my %opts = ();
+getopts( 'r:', \%opts );
+my %remap = ();
+if( defined $opts{r} ) {
+	open( my $fh, '<', $opts{r} ) || die "$opts{r}: $!\n";
+	while( my $line = <$fh> ) {
+		if( $line =~ /^(\d+)\s+(\d+)/ ) {
+			$remap{$1} = $2;
+		}
+	}
+	close( $fh );
+}
+
 my $name = $ARGV[0] || '';
 
 if( $name eq '' ) {
@@ -167,6 +184,7 @@ for( my $x = 0 ; $x < $width ; $x++ ) {
 		do {
 			my $repeat = 0;
 			my $c = $charmap{ substr($coldata,$y,1) };
+			$c = $remap{$c} if( exists $remap{$c} );
 
 			printf "0x%02x, ", $c;
 			$bytes++;
@@ -0,0 +1,57 @@
+#!/usr/bin/perl -w
+
+#
+# Sprite collision masks.
+#
+# (c) Copyright 2011 Steve Maddison
+#
+# Input:      The sprite tiles output by gconvert, accompanied by a ".col"
+#             file holding the solid quadrants of each tile.
+# Processing: Copies the quadrant masks, and for each tile also works out
+#             a finer mask of 2x2 pixel cells. A cell is solid if it lies
+#             in a solid quadrant and isn't all transparent (the colour of
+#             the top-left pixel of tile 0).
+# Output:     C source file containing sprite_col_map[] and, when COL_FINE
+#             is set, sprite_col_fine[] with 16 cells per tile, the top-left
+#             one in the most significant bit.
+#
+
+use strict;
+use FindBin;
+use lib $FindBin::Bin;
+use TileData;
+
+my $file = $ARGV[0] || '';
+
+if( $file eq '' ) {
+	die "No file name provided\n";
+}
+
+my @tiles = read_tiles( $file );
+my @col = read_col( $file );
+my $clear = $tiles[0][0];
+
+if( @col > @tiles ) {
+	die "$file: more collision masks than tiles\n";
+}
+
+print "//\n";
+print "// Generated sprite collision masks\n";
+print "//\n";
+print "\n";
+print "const unsigned char sprite_col_map[] PROGMEM = {\n";
+for( my $i = 0 ; $i < @col ; $i += 8 ) {
+	my $end = $i+7 < $#col ? $i+7 : $#col;
+	print "\t", join( ', ', map { sprintf "0x%02x", $_ } @col[$i..$end] ), ( $end < $#col ? "," : "" ), "\n";
+}
+print "};\n";
+print "\n";
+print "#if COL_FINE\n";
+print "const unsigned int sprite_col_fine[] PROGMEM = {\n";
+for( my $i = 0 ; $i < @col ; $i += 8 ) {
+	my $end = $i+7 < $#col ? $i+7 : $#col;
+	print "\t", join( ', ', map { sprintf "0x%04x", fine_mask( $tiles[$_], $col[$_], $clear ) } ($i..$end) ), ( $end < $#col ? "," : "" ), "\n";
+}
+print "};\n";
+print "#endif\n";
+print "\n";
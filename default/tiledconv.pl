@@ -6,6 +6,8 @@
 # (c) Copyright 2011 Steve Maddison
 # 
 # Input:      Saved file from "Tiled" program, XML/CSV format.
+#             Optionally, "-r file" names a tile remap file from
+#             tilemerge.pl to translate the tile numbers through.
 # Processing: Encodes the data into columns, replacing subsequent
 #             occurrences of the same character with a meta-char
 #             followed by a count. Also encodes identical subsequent
@@ -15,6 +17,7 @@
 #
 
 use strict;
+use Getopt::Std;
 
 my %enemy_tile = ();
 my %enemy_top_left = ();
@@ -24,6 +27,20 @@ my $height = 0;
 my @rowdata;
 my $bytes = 0;
 
+# Optional tile remap file, as written by tilemerge.pl.
+my %opts = ();
+getopts( 'r:', \%opts );
+my %remap = ();
+if( defined $opts{r} ) {
+	open( my $fh, '<', $opts{r} ) || die "$opts{r}: $!\n";
+	while( my $line = <$fh> ) {
+		if( $line =~ /^(\d+)\s+(\d+)/ ) {
+			$remap{$1} = $2;
+		}
+	}
+	close( $fh );
+}
+
 my $name = $ARGV[0] || '';
 
 if( $name eq '' ) {
@@ -170,6 +187,9 @@ for( my $x = 0 ; $x < $width ; $x++ ) {
 			if( exists $enemy_tile{ $coldata[$y] } ) {
 				$coldata[$y] = 0;
 			}
+			elsif( exists $remap{ $coldata[$y] } ) {
+				$coldata[$y] = $remap{ $coldata[$y] };
+			}
 
 			if( !@prev_coldata || @prev_coldata > 0 && $coldata[$y] != $prev_coldata[$y] ) {
 				$same = 0;
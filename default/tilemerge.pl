@@ -0,0 +1,412 @@
+#!/usr/bin/perl -w
+
+#
+# Merge the tile sets into a single table with duplicate tiles removed.
+#
+# (c) Copyright 2011 Steve Maddison
+#
+# Input:      The tile sets output by gconvert, in the order tiles1,
+#             overlay, tiles2, each accompanied by a ".col" file holding
+#             the background collision mask for each of its tiles.
+# Processing: Video mode 3 addresses a tile set as a window of up to
+#             VIEW_SIZE tiles, starting anywhere in flash. Tile set 0 is
+#             tiles1 followed by the overlay and is kept exactly as drawn.
+#             Tile set 1 is the overlay followed by tiles2, so its window
+#             is placed to overlap the end of set 0, as far back as the
+#             window size allows while still starting on a blank tile.
+#             Any tile from tiles2 which is identical (in both pixels and
+#             collision mask) to one already inside the window is dropped
+#             and remapped to the existing copy. Unused padding at the
+#             end of each sheet is dropped too.
+#             Given the animation list (-a), frames marked with "shift"
+#             get a copy moved right by that many pixels, one column
+#             wider, built from new tiles where the set has room for them.
+# Output:     C source file containing the merged tile table, the base of
+#             each set, the collision maps for both sets and a TILE2()
+#             macro to translate tiles2 sheet indices. Pre-shifted frames
+#             are listed as every cell to draw, blanks included, with a
+#             SHIFT_<NAME>_<FRAME>_<PIXELS> id for each. Finer collision
+#             maps of 2x2 pixel cells are included for COL_FINE builds.
+#             A remap file for the level converters is written alongside
+#             tiles2's input.
+#
+
+use strict;
+use Getopt::Std;
+use FindBin;
+use lib $FindBin::Bin;
+use TileData;
+
+# 256 possible VRAM values, less the RAM tiles (see RAM_TILES_COUNT).
+my $VIEW_SIZE = 256 - 24;
+
+my %opts = ();
+getopts( 'a:', \%opts );
+
+if( @ARGV != 3 ) {
+	die "Usage: $0 [-a anims.txt] tiles1.inc overlay.inc tiles2.inc\n";
+}
+
+my ( $tiles1_file, $overlay_file, $tiles2_file ) = @ARGV;
+
+my @tiles1  = read_tiles( $tiles1_file );
+my @overlay = read_tiles( $overlay_file );
+my @tiles2  = read_tiles( $tiles2_file );
+my $input_tiles = @tiles1 + @overlay + @tiles2;
+
+my @tiles1_col  = read_col( $tiles1_file );
+my @overlay_col = read_col( $overlay_file );
+my @tiles2_col  = read_col( $tiles2_file );
+
+my $overlay_size = scalar( @overlay );
+my $set_size = $VIEW_SIZE - $overlay_size;
+
+# Set 0 is tiles1 padded or trimmed to fit, followed by the overlay.
+if( @tiles1 < $set_size ) {
+	die "$tiles1_file: only ", scalar(@tiles1), " tiles, need $set_size\n";
+}
+splice( @tiles1, $set_size );
+
+my @storage = ( @tiles1, @overlay );
+my @storage_col = ();
+for( my $t = 0 ; $t < $set_size ; $t++ ) {
+	push( @storage_col, defined $tiles1_col[$t] ? $tiles1_col[$t] : 0 );
+}
+push( @storage_col, @overlay_col[0..$overlay_size-1] );
+
+# The tiles2 sheet reserves its first slots for the overlay, and anything
+# past the end of the window can never be addressed.
+my $last = @tiles2 < $VIEW_SIZE ? scalar(@tiles2) : $VIEW_SIZE;
+my @set2 = ();
+for( my $t = $overlay_size ; $t < $last ; $t++ ) {
+	my $c = $tiles2_col[$t-$overlay_size];
+	push( @set2, { data => $tiles2[$t], col => defined $c ? $c : 0 } );
+}
+
+# Try every window start from the beginning of the overlay backwards,
+# keeping the one which needs the fewest new tiles. Tile 0 of each set
+# must be the blank tile, as ClearVram() and the game rely on that.
+my $best_base = -1;
+my @best_remap = ();
+my @best_new = ();
+my $blank = key( $storage[$set_size], $storage_col[$set_size] );
+
+for( my $base = $set_size ; $base >= 0 ; $base-- ) {
+	next if( key( $storage[$base], $storage_col[$base] ) ne $blank );
+
+	my %window = ();
+	for( my $t = scalar(@storage)-1 ; $t >= $base ; $t-- ) {
+		$window{ key( $storage[$t], $storage_col[$t] ) } = $t - $base;
+	}
+
+	my @remap = ();
+	my @new = ();
+	my $next = scalar(@storage) - $base;
+	foreach my $tile ( @set2 ) {
+		my $k = key( $tile->{data}, $tile->{col} );
+		if( !exists $window{$k} ) {
+			$window{$k} = $next++;
+			push( @new, $tile );
+		}
+		push( @remap, $window{$k} );
+	}
+
+	last if( $next > $VIEW_SIZE );
+
+	if( $best_base < 0 || @new < @best_new ) {
+		$best_base = $base;
+		@best_remap = @remap;
+		@best_new = @new;
+	}
+}
+
+if( $best_base < 0 ) {
+	die "$tiles2_file: too many unique tiles to fit in a tile set\n";
+}
+
+foreach my $tile ( @best_new ) {
+	push( @storage, $tile->{data} );
+	push( @storage_col, $tile->{col} );
+}
+
+my $overlay1 = $set_size - $best_base;
+
+# Pre-shifted animation frames. All tiles for a frame must fit in every set
+# it's drawn with, or the frame is left out.
+my @shifts = ();
+if( defined $opts{a} ) {
+	foreach my $sh ( read_shifts( $opts{a} ) ) {
+		my @sets = ();
+		push( @sets, [ 'tiles1', 0 ] ) if( $sh->{sets} ne 'tiles2' );
+		push( @sets, [ 'tiles2', $best_base ] ) if( $sh->{sets} ne 'tiles1' );
+
+		my @lists = ();
+		my @added = ();
+		foreach my $set ( @sets ) {
+			my $list = place_shift( $sh, $set->[0], $set->[1], \@added );
+			last if( !defined $list );
+			push( @lists, $list );
+		}
+		if( @lists != @sets ) {
+			# Take back anything added for the other set.
+			splice( @storage, -scalar(@added) ) if( @added );
+			splice( @storage_col, -scalar(@added) ) if( @added );
+			print STDERR "$0: no room for $sh->{id}, left out\n";
+			next;
+		}
+		push( @lists, $lists[0] ) if( @lists == 1 );
+		$sh->{lists} = \@lists;
+		push( @shifts, $sh );
+	}
+}
+my @remap2 = ();
+for( my $t = 0 ; $t < $overlay_size ; $t++ ) {
+	$remap2[$t] = $t + $overlay1;
+}
+push( @remap2, @best_remap );
+
+# Remap file for the level converters: "sheet_index new_index" per line.
+my $remap_file = $tiles2_file;
+$remap_file =~ s/\.inc$/.remap/;
+open( my $rf, '>', $remap_file ) || die "$remap_file: $!\n";
+for( my $t = 0 ; $t < @remap2 ; $t++ ) {
+	print $rf "$t $remap2[$t]\n";
+}
+close( $rf );
+
+my $out_bytes = 64 * scalar(@storage);
+
+print "//\n";
+print "// Generated merged tile table\n";
+print "// Tile set 0: tiles 0-", $VIEW_SIZE-1, ", overlay at $set_size\n";
+print "// Tile set 1: tiles $best_base-", $best_base+scalar(@remap2)-1, ", overlay at $overlay1\n";
+print "//\n";
+print "\n";
+print "#define TILESET_SIZE     $VIEW_SIZE\n";
+print "#define TILESET0_OVERLAY $set_size\n";
+print "#define TILESET1_OVERLAY $overlay1\n";
+print "\n";
+print "const char tiles_merged[] PROGMEM = {\n";
+for( my $t = 0 ; $t < @storage ; $t++ ) {
+	my @bytes = @{ $storage[$t] };
+	for( my $i = 0 ; $i < @bytes ; $i += 16 ) {
+		print "\t", join( ',', map { sprintf "0x%02x", $_ } @bytes[$i..$i+15] ), ",";
+		print " // Tile $t" if( $i == 0 );
+		print "\n";
+	}
+}
+print "};\n";
+print "\n";
+print "#define tiles1        (tiles_merged)\n";
+print "#define overlay_tiles (tiles_merged+(TILESET0_OVERLAY*64))\n";
+print "#define tiles2        (tiles_merged+($best_base*64))\n";
+print "\n";
+
+# Compile-time translation of tiles2 sheet indices, as a run of ranges.
+print "#define TILE2(n) ( \\\n";
+my $start = 0;
+for( my $t = 1 ; $t <= @remap2 ; $t++ ) {
+	if( $t == @remap2 || $remap2[$t] - $t != $remap2[$start] - $start ) {
+		my $offset = $remap2[$start] - $start;
+		if( $t == @remap2 ) {
+			print "\t(n)", ( $offset < 0 ? "-" : "+" ), abs($offset), " )\n";
+		}
+		else {
+			print "\t(n) < $t ? (n)", ( $offset < 0 ? "-" : "+" ), abs($offset), " : \\\n";
+		}
+		$start = $t;
+	}
+}
+print "\n";
+
+print "#define SHIFT_COUNT ", scalar(@shifts), "\n";
+if( @shifts ) {
+	for( my $i = 0 ; $i < @shifts ; $i++ ) {
+		my $sh = $shifts[$i];
+		my $var = lc( $sh->{id} );
+		print "#define $sh->{id} $i\n";
+		print "const unsigned char ${var}[2][", scalar(@{ $sh->{lists}[0] })*2+1, "] PROGMEM = {\n";
+		for( my $s = 0 ; $s < 2 ; $s++ ) {
+			print "\t{ ", scalar(@{ $sh->{lists}[$s] });
+			foreach my $c ( @{ $sh->{lists}[$s] } ) {
+				printf ",  0x%02x,%d", $c->[0], $c->[1];
+			}
+			print " }", ( $s == 0 ? "," : "" ), "\n";
+		}
+		print "};\n";
+	}
+	print "const unsigned char * const anim_shifts[SHIFT_COUNT][2] PROGMEM = {\n";
+	for( my $i = 0 ; $i < @shifts ; $i++ ) {
+		my $var = lc( $shifts[$i]{id} );
+		print "\t{ ${var}[0], ${var}[1] }", ( $i < $#shifts ? "," : "" ), "\n";
+	}
+	print "};\n";
+}
+print "\n";
+
+print "const unsigned char bg_col_map[2][TILESET_SIZE] PROGMEM = {\n";
+print_col( @storage_col[0..$VIEW_SIZE-1] );
+print ",\n";
+my @col1 = ();
+for( my $t = 0 ; $t < $VIEW_SIZE ; $t++ ) {
+	my $s = $best_base + $t;
+	push( @col1, $s < @storage_col ? $storage_col[$s] : 0 );
+}
+print_col( @col1 );
+print "\n};\n";
+print "\n";
+
+# Finer masks of 2x2 pixel cells, for COL_FINE builds. A cell is solid if
+# it's in a solid quadrant and not all the blank tile's colour.
+my $clear = $storage[0][0];
+print "#if COL_FINE\n";
+print "const unsigned int bg_col_fine[2][TILESET_SIZE] PROGMEM = {\n";
+print_fine( map { fine_mask( $storage[$_], $storage_col[$_], $clear ) } (0..$VIEW_SIZE-1) );
+print ",\n";
+print_fine( map { $best_base+$_ < @storage ? fine_mask( $storage[$best_base+$_], $storage_col[$best_base+$_], $clear ) : 0 } (0..$VIEW_SIZE-1) );
+print "\n};\n";
+print "#endif\n";
+print "\n";
+
+print "// STATISTICS:\n";
+print "// Input tiles  = $input_tiles (", $input_tiles*64, " bytes)\n";
+print "// Merged tiles = ", scalar(@storage), " ($out_bytes bytes)\n";
+print "// Saved        = ", ($input_tiles*64) - $out_bytes, " bytes\n";
+print "\n";
+
+# Shift directives from the animation list: "shift <frame> <pixels>".
+sub read_shifts {
+	my ( $file ) = @_;
+	my @list = ();
+	my $anim;
+
+	open( my $fh, '<', $file ) || die "$file: $!\n";
+	while( my $line = <$fh> ) {
+		$line =~ s/#.*$//;
+		if( $line =~ /^anim\s+(\w+)\s+(\d+)\s+(\d+)\s*(\w*)/ ) {
+			$anim = { name => $1, width => $2, height => $3, sets => $4 || 'tiles1', frames => [] };
+		}
+		elsif( $line =~ /^frame/ ) {
+			push( @{ $anim->{frames} }, [] );
+		}
+		elsif( $line =~ /^\s+[\d\s]+$/ && defined $anim ) {
+			push( @{ $anim->{frames}[-1] }, split( ' ', $line ) );
+		}
+		elsif( $line =~ /^shift\s+(\d+)\s+(\d+)/ ) {
+			die "$file: shift outside of animation\n" if( !defined $anim );
+			die "$file: $anim->{name}: shift must be 1-7 pixels\n" if( $2 < 1 || $2 > 7 );
+			push( @list, {
+				id     => uc( "SHIFT_$anim->{name}_$1_$2" ),
+				anim   => $anim,
+				frame  => $1,
+				pixels => $2,
+				sets   => $anim->{sets}
+			} );
+		}
+	}
+	close( $fh );
+
+	# Frames are only complete once the whole file is read.
+	foreach my $sh ( @list ) {
+		if( !defined $sh->{anim}{frames}[ $sh->{frame} ] ) {
+			die "$file: $sh->{anim}{name}: no frame $sh->{frame} to shift\n";
+		}
+	}
+	return @list;
+}
+
+# Build the shifted frame's tiles for one set, reusing any already in its
+# window and adding the rest to the end of the table. Returns the list of
+# [ (y<<4)|x, tile ] cells, or undef if the window is full.
+sub place_shift {
+	my ( $sh, $set, $base, $added ) = @_;
+	my $w = $sh->{anim}{width};
+	my $h = $sh->{anim}{height};
+	my $frame = $sh->{anim}{frames}[ $sh->{frame} ];
+	my $offset = $sh->{pixels};
+	my @sheet = $set eq 'tiles1' ? @tiles1 : @tiles2;
+	my $blank = $sheet[0][0];
+	my @cells = ();
+
+	my %window = ();
+	my $end = $set eq 'tiles1' ? $VIEW_SIZE : scalar(@storage) - $base;
+	for( my $t = $end-1 ; $t >= 0 ; $t-- ) {
+		$window{ key( $storage[$base+$t], $storage_col[$base+$t] ) } = $t;
+	}
+
+	for( my $y = 0 ; $y < $h ; $y++ ) {
+		for( my $x = 0 ; $x <= $w ; $x++ ) {
+			my @data = ();
+			my $col = 0;
+			for( my $py = 0 ; $py < 8 ; $py++ ) {
+				for( my $px = 0 ; $px < 8 ; $px++ ) {
+					my $sx = ($x*8) + $px - $offset;
+					if( $sx < 0 || $sx >= $w*8 ) {
+						push( @data, $blank );
+					}
+					else {
+						my $t = $frame->[ ($y*$w) + int($sx/8) ];
+						push( @data, $t ? $sheet[$t][ ($py*8) + ($sx%8) ] : $blank );
+					}
+				}
+			}
+			# A quadrant is solid if any part of it came from a solid one.
+			for( my $q = 0 ; $q < 2 ; $q++ ) {
+				for( my $px = $q*4 ; $px < ($q+1)*4 ; $px++ ) {
+					my $sx = ($x*8) + $px - $offset;
+					next if( $sx < 0 || $sx >= $w*8 );
+					my $t = $frame->[ ($y*$w) + int($sx/8) ];
+					next if( !$t );
+					my $c = sheet_col( $set, $t );
+					my $src = ($sx%8) < 4 ? 0x0a : 0x05;
+					my $bits = $c & $src;
+					$bits = $q ? $bits >> 1 : $bits << 1 if( ($src == 0x0a) != ($q == 0) );
+					$col |= $bits;
+				}
+			}
+
+			my $k = key( \@data, $col );
+			if( !exists $window{$k} ) {
+				my $t = scalar(@storage) - $base;
+				return undef if( $set eq 'tiles1' || $t >= $VIEW_SIZE );
+				push( @storage, \@data );
+				push( @storage_col, $col );
+				push( @$added, $t );
+				$window{$k} = $t;
+			}
+			push( @cells, [ ($y<<4)|$x, $window{$k} ] );
+		}
+	}
+	return \@cells;
+}
+
+sub sheet_col {
+	my ( $set, $t ) = @_;
+	my $c = $set eq 'tiles1' ? $tiles1_col[$t] : $tiles2_col[$t-$overlay_size];
+	return defined $c ? $c : 0;
+}
+
+sub key {
+	my ( $data, $col ) = @_;
+	return join( ',', @$data ) . ":$col";
+}
+
+sub print_fine {
+	my @fine = @_;
+	print "\t{\n";
+	for( my $i = 0 ; $i < @fine ; $i += 8 ) {
+		my $end = $i+7 < $#fine ? $i+7 : $#fine;
+		print "\t\t", join( ', ', map { sprintf "0x%04x", $_ } @fine[$i..$end] ), ",\n";
+	}
+	print "\t}";
+}
+
+sub print_col {
+	my @col = @_;
+	print "\t{\n";
+	for( my $i = 0 ; $i < @col ; $i += 16 ) {
+		my $end = $i+15 < $#col ? $i+15 : $#col;
+		print "\t\t", join( ', ', map { sprintf "0x%02x", $_ } @col[$i..$end] ), ",\n";
+	}
+	print "\t}";
+}
@@ -19,6 +19,7 @@
 #include <stdbool.h>
 #include <avr/io.h>
 #include <stdlib.h>
+#include <string.h>
 #include <avr/pgmspace.h>
 #include <uzebox.h>
 // Not in header...
@@ -27,76 +28,83 @@ void SetScrolling(char sx,char sy);
 #define LEVEL_TILES_Y  24
 #define FPS            60
 
-#include "data/tiles1.inc"
-#include "data/overlay.inc"
-#include "data/tiles2.inc"
+// Test sprites against the background in 2x2 pixel cells, rather than
+// quarters of each tile. Off by default, as the masks and tables take
+// about 1KB more flash.
+#ifndef COL_FINE
+#define COL_FINE 0
+#endif
+
+// Furthest a sprite can move between tests without being able to pass
+// through anything: the width of a collision cell.
+#if COL_FINE
+#define COL_STEP 2
+#else
+#define COL_STEP 4
+#endif
+#define COL_CELLS (8/COL_STEP)		// Across or down a tile
+
+// tiles1, overlay_tiles and tiles2 are windows into one merged table,
+// see tilemerge.pl. Tiles from tiles2 must be referred to via TILE2().
+#include "data/tiles.inc"
 #include "data/sprites.inc"
+#include "data/spritecol.inc"
 #include "data/sfx.inc"
 
-#define TILES_PER_SET 168
+#define TILES_PER_SET TILESET0_OVERLAY
 
+#define MAX_ENEMIES  12
+#define HP_INFINITE -1
+#define PRIO_COSMETIC 0
+#define PRIO_NORMAL   1
+#define PRIO_HIGH     2			// Only used for sprites, see mux_t
+
+// Everything the game knows about each type of enemy, one line apiece.
+// enemy_id_t and the enemy_*[] tables are all generated from this list.
+//   hp     - hit points, or HP_INFINITE if it can't be destroyed
+//   score  - awarded for destroying it
+//   foot   - SIZE(w,h) of the tiles cleared when it's removed
+//   hitbox - SIZE(w,h) of the tiles which can be hit, from its position
+//   dies   - what it turns into when destroyed
+//   prio   - PRIO_COSMETIC ones are dropped to make room when the pool is full
+//   script - animation script for run_script()
+//   update - called whenever its wait runs out
+//   killed - any extra clean-up when destroyed, or the effect of a power-up
+//            when collected
+//   erase  - removes it from the screen, if clearing foot isn't enough
+#define ENEMY_LIST \
+	/* id                     hp           score foot       hitbox     dies           prio           script                  update       killed          erase */ \
+	X( ENEMY_NONE,            0,           0,    SIZE(0,0), SIZE(0,0), ENEMY_NONE,    PRIO_NORMAL,   NULL,                   NULL,        NULL,           NULL ) \
+	/* Level 1... */ \
+	X( ENEMY_MINE,            5,           1000, SIZE(2,2), SIZE(2,2), ENEMY_EXP_2X2, PRIO_NORMAL,   mine_script,            run_script,  NULL,           NULL ) \
+	X( ENEMY_MORTAR_LAUNCHER, 3,           1250, SIZE(2,2), SIZE(2,2), ENEMY_EXP_2X2, PRIO_NORMAL,   mortar_launcher_script, run_script,  NULL,           NULL ) \
+	X( ENEMY_MORTAR,          HP_INFINITE, 0,    SIZE(1,1), SIZE(0,0), ENEMY_NONE,    PRIO_NORMAL,   mortar_script,          run_script,  NULL,           NULL ) \
+	X( ENEMY_SPINNER,         1,           200,  SIZE(4,2), SIZE(3,2), ENEMY_EXP_3X2, PRIO_NORMAL,   spinner_script,         run_script,  NULL,           NULL ) \
+	X( ENEMY_EYEBALL,         16,          2500, SIZE(0,0), SIZE(2,2), ENEMY_EXP_2X2, PRIO_NORMAL,   eyeball_script,         run_script,  eyeball_killed, NULL ) \
+	X( ENEMY_TENTACLE,        HP_INFINITE, 0,    SIZE(0,0), SIZE(0,0), ENEMY_NONE,    PRIO_NORMAL,   tentacle_script,        run_script,  NULL,           NULL ) \
+	/* Level 2... */ \
+	X( ENEMY_ALIEN,           3,           300,  SIZE(0,0), SIZE(0,0), ENEMY_NONE,    PRIO_NORMAL,   NULL,                   NULL,        NULL,           NULL ) \
+	X( ENEMY_SPIKE_BALL,      HP_INFINITE, 0,    SIZE(0,0), SIZE(0,0), ENEMY_NONE,    PRIO_NORMAL,   NULL,                   NULL,        NULL,           NULL ) \
+	X( ENEMY_WORM,            25,          3000, SIZE(3,2), SIZE(3,2), ENEMY_EXP_3X2, PRIO_NORMAL,   NULL,                   update_worm, NULL,           worm_erase ) \
+	/* Level 3... */ \
+	X( ENEMY_HORNET,          3,           400,  SIZE(3,2), SIZE(2,2), ENEMY_EXP_3X2, PRIO_NORMAL,   hornet_script,          run_script,  NULL,           NULL ) \
+	\
+	X( ENEMY_EXP_2X2,         HP_INFINITE, 0,    SIZE(2,2), SIZE(0,0), ENEMY_NONE,    PRIO_COSMETIC, explosion_2x2_script,   run_script,  NULL,           NULL ) \
+	X( ENEMY_EXP_3X2,         HP_INFINITE, 0,    SIZE(3,2), SIZE(0,0), ENEMY_NONE,    PRIO_COSMETIC, explosion_3x2_script,   run_script,  NULL,           NULL ) \
+	\
+	X( POWER_UP_SPEED,        HP_INFINITE, 0,    SIZE(3,3), SIZE(3,3), ENEMY_NONE,    PRIO_NORMAL,   power_up_script,        run_script,  collect_speed,  NULL ) \
+	X( POWER_UP_BOMB,         HP_INFINITE, 0,    SIZE(3,3), SIZE(3,3), ENEMY_NONE,    PRIO_NORMAL,   power_up_script,        run_script,  collect_bomb,   NULL ) \
+	X( POWER_UP_CHARGE,       HP_INFINITE, 0,    SIZE(3,3), SIZE(3,3), ENEMY_NONE,    PRIO_NORMAL,   power_up_script,        run_script,  collect_speed,  NULL ) \
+	X( POWER_UP_MISSILE,      HP_INFINITE, 0,    SIZE(3,3), SIZE(3,3), ENEMY_NONE,    PRIO_NORMAL,   power_up_script,        run_script,  collect_missile, NULL )
+
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) id,
 typedef enum {
-	ENEMY_NONE,
-	// Level 1...
-	ENEMY_MINE,
-	ENEMY_MORTAR_LAUNCHER,
-	ENEMY_MORTAR,
-	ENEMY_SPINNER,
-	ENEMY_EYEBALL,
-	ENEMY_TENTACLE,
-
-	// Level 2...
-	ENEMY_ALIEN,
-	ENEMY_SPIKE_BALL,
-	ENEMY_WORM,
-
-	// Level 3...
-	ENEMY_HORNET,
-
-	ENEMY_EXP_2X2,
-	ENEMY_EXP_3X2,
-
-	POWER_UP_SPEED,
-	POWER_UP_BOMB,
-	POWER_UP_CHARGE,
-	POWER_UP_MISSILE,
-
+	ENEMY_LIST
 	ENEMY_COUNT
 } enemy_id_t;
+#undef X
 
-#define MAX_ENEMIES  8
-#define HP_INFINITE -1
-const char enemy_hp[ENEMY_COUNT] PROGMEM = {
-	0,
-	5,				// Mine
-	3,				// Mortar Launcher
-	HP_INFINITE,	// Mortar
-	1,				// Spinner
-	16,				// Eyeball
-	HP_INFINITE,	// Tentacle
-	
-	3,				// Alien
-	HP_INFINITE,	// Spike ball
-	25,				// Worm
-
-	3				// Hornet
-};
-
-const int enemy_score[ENEMY_COUNT] PROGMEM = {
-	0,
-	1000,	// Mine
-	1250,	// Mortar Launcher
-	0,
-	200,	// Spinner
-	2500,	// Eyeball
-	0,		// Tentacle
-	
-	300,	// Alien
-	0,		// Spike ball
-	3000,	// Worm
-
-	400		// Hornet
-};
+#define IS_POWER_UP(id) ((id) >= POWER_UP_SPEED)
 
 typedef struct {
 	int x;
@@ -104,14 +112,28 @@ typedef struct {
 	char id;
 } enemy_def_t;
 
+// The enemy pool keeps one array per field. Live enemies are listed in
+// enemy_active[], each knowing its own position there (slot), so they can
+// be removed in constant time. Unused entries are stacked in enemy_free[].
 typedef struct {
-	char x;
-	char y;
-	char id;
-	char hp;
-	int anim_step;
-	unsigned char whooshed;
-} enemy_t;
+	int x[MAX_ENEMIES];						// Level column
+	char y[MAX_ENEMIES];
+	char id[MAX_ENEMIES];
+	char hp[MAX_ENEMIES];
+	unsigned char pc[MAX_ENEMIES];			// Offset into the enemy's animation script
+	unsigned char laps[MAX_ENEMIES];		// Timer wheel laps to go before waking
+	unsigned char count[MAX_ENEMIES];		// Loop counter for A_COUNT/A_LOOP
+	unsigned char flags[MAX_ENEMIES];
+	unsigned char whooshed[MAX_ENEMIES];
+	unsigned char slot[MAX_ENEMIES];		// Position in enemy_active[]
+	unsigned char wheel[MAX_ENEMIES];		// Timer wheel slot, or WHEEL_NONE
+	unsigned char next[MAX_ENEMIES];		// Links within the timer wheel slot
+	unsigned char prev[MAX_ENEMIES];
+} enemy_pool_t;
+
+// Enemy flags
+#define EF_SHIELDED 0x01	// Can't be hit
+#define EF_DOOMED   0x02	// Destroyed by a power bomb, waiting to explode
 
 #include "data/level1.inc"
 #include "data/level2.inc"
@@ -136,9 +158,9 @@ const enemy_def_t * const enemy_data[LEVELS] PROGMEM = {
 const char random_tiles[LEVELS+1][3] PROGMEM = {
 	{ TILES_PER_SET+45, TILES_PER_SET+46, TILES_PER_SET+47 },
 	{ TILES_PER_SET+45, TILES_PER_SET+46, TILES_PER_SET+47 },
-	{ 59, 60, 61 },
+	{ TILE2(59), TILE2(60), TILE2(61) },
 	{ 45, 46, 47 },
-	{ 46, 100, 116 }
+	{ TILE2(46), TILE2(100), TILE2(116) }
 };
 
 const char ship_map[2][6] PROGMEM = {
@@ -148,13 +170,18 @@ const char ship_map[2][6] PROGMEM = {
 			25, 26, 27 }
 };
 
+// Where each sprite of a metasprite's map goes, as x,y from its origin.
+const char ship_layout[8] PROGMEM = {
+	0,0,	0,8,	8,8,	16,8
+};
+
 const char power_up_map[2][11] PROGMEM = {
 	{ 3,3,	54+TILES_PER_SET, 0, 55+TILES_PER_SET,
 			0,      0,  0,
 			56+TILES_PER_SET, 0, 57+TILES_PER_SET },
-	{ 3,3,	39, 0, 40,
-			0,  0,  0,
-			41, 0, 42 }
+	{ 3,3,	TILE2(39), 0, TILE2(40),
+			0,         0, 0,
+			TILE2(41), 0, TILE2(42) }
 };
 
 #define EXPLOSION_FRAMES_S 2
@@ -164,21 +191,8 @@ const char ship_explosion_map[EXPLOSION_FRAMES_S][6] PROGMEM = {
 	{ 2,2,	22, 30,
 			31, 23 }
 };
-const char explosion_map_2x2[EXPLOSION_FRAMES_S][6] PROGMEM = {
-	{ 2,2,	144, 145,
-			160, 161 },
-	{ 2,2,	146, 147,
-			162, 163 }
-};
-
-#define EXPLOSION_FRAMES_M 3
-const char explosion_map_3x2[EXPLOSION_FRAMES_M][8] PROGMEM = {
-	{ 3,2,	144, 145, 0,
-			160, 161, 0 },
-	{ 3,2,	146, 144, 145,
-			162, 160, 161 },
-	{ 3,2,	147, 146, 147,
-			163, 162, 163 }
+const char ship_explosion_layout[8] PROGMEM = {
+	0,0,	0,8,	8,8,	8,0
 };
 
 #define WHOOSH_FRAMES 2
@@ -186,31 +200,26 @@ const char whoosh_map[] PROGMEM = {
 	4,2,	32, 33, 34, 35,
 			40, 41, 42, 43
 };
+const char whoosh_layout[16] PROGMEM = {
+	0,0,	8,0,	16,0,	24,0,
+	0,8,	8,8,	16,8,	24,8
+};
 
-const char mine_map[2][6] PROGMEM = {
-	{ 2,2,	30,31,
-			46,47 },
-	{ 2,2,	30,31,
-			62,47 }
+const char alien_map[] PROGMEM = {
+	2,1,	13, 14
 };
 
-const char spinner_map[4][8] PROGMEM = {
-	{ 3,2,	68,69,70,
-			84,85,86 },
-	{ 3,2,	71,72,73,
-			87,88,89 },
-	{ 3,2,	74,75,76,
-			90,91,92 },
-	{ 3,2,	77,78,79,
-			93,94,95 }
+const char alien_explosion_map[2][4] PROGMEM = {
+	{ 2,1,	20, 28 },
+	{ 2,1,	22, 30 }
 };
 
-const char eyeball_map[2][6] PROGMEM = {
-	{ 2,2,	66,67,
-			82,83 },
-	{ 2,2,	64,65,
-			80,81 }
+#define ALIEN_WAVE_STEPS 32
+const char alien_wave[ALIEN_WAVE_STEPS] PROGMEM = {
+	  0,   2,   5,   7,   8,  10,  11,  12,  12,  12,  11,  10,   8,   7,   5,   2,
+	  0,  -2,  -5,  -7,  -8, -10, -11, -12, -12, -12, -11, -10,  -8,  -7,  -5,  -2
 };
+
 const char dead_eyeball_map[10] PROGMEM = {
 	2,4,	96,0,
 			0,66,
@@ -218,25 +227,284 @@ const char dead_eyeball_map[10] PROGMEM = {
 			48,0
 };
 
-const char tentacle_map[2][6] PROGMEM = {
-	{ 4,1,	50,51,50,51 },
-	{ 4,1,	51,50,51,50 }
-};
-
 const char mortar_map[6] PROGMEM = {
 	2,2,	112,113,
 			128,129
 };
+const char worm_head_map[8] PROGMEM = {
+	3,2,	109,110,111,
+			125,126,127
+};
+const char worm_body_map[8] PROGMEM = {
+	3,2,	141,142,143,
+			157,158,159
+};
+
 #define MORTAR_TL	114
 #define MORTAR_BR	130
+#define LAVA_TILE	TILE2(112)
+
+// Animated tiles are user RAM tiles. Vram points at them once, and each
+// step of the animation only changes their pixels, so every cell showing
+// one changes along with it. Tile numbers for them, as given to SetTile()
+// and in maps, come from ANIM_TILE(). Only those used by the current tile
+// set are reserved, leaving the rest of the RAM tiles to the sprites.
+#define ANIM_LAVA        0		// tiles2
+#define ANIM_BEAM_TOP    0		// tiles1...
+#define ANIM_BEAM_BOTTOM 1
+#define ANIM_TENTACLE_A  2
+#define ANIM_TENTACLE_B  3
+#define ANIM_TILES       4		// The most for either set
+#define ANIM_TILE(a)     ((a) + 256 - RAM_TILES_COUNT)
+
+#define TENTACLE_FRAMES  20
+#define LAVA_FRAMES      8
+
+// All tentacles wave together, so they're drawn just once.
+const char tentacle_anim_map[6] PROGMEM = {
+	4,1,	ANIM_TILE(ANIM_TENTACLE_A), ANIM_TILE(ANIM_TENTACLE_B), ANIM_TILE(ANIM_TENTACLE_A), ANIM_TILE(ANIM_TENTACLE_B)
+};
+
+#include "data/anims.inc"
+
+// Frames which can be drawn in full by an animation script, per tile
+// set. Once drawn, animations move between frames with A_DELTA, using
+// the change lists in anim_deltas[].
+typedef enum {
+	FRAME_MINE,
+	FRAME_MORTAR_LAUNCHER,
+	FRAME_SPINNER,
+	FRAME_EYEBALL,
+	FRAME_TENTACLE,
+	FRAME_HORNET,
+	FRAME_POWER_UP,
+	FRAME_EXP_2X2,
+	FRAME_EXP_3X2,
+	FRAME_COUNT
+} frame_id_t;
+
+const char * const anim_frames[FRAME_COUNT][2] PROGMEM = {
+	{ mine_map[0],              mine_map[0] },
+	{ mortar_map,               mortar_map },
+	{ spinner_map[0],           spinner_map[0] },
+	{ eyeball_map[0],           eyeball_map[0] },
+	{ tentacle_anim_map,        tentacle_anim_map },
+	{ hornet_map[0],            hornet_map[0] },
+	{ power_up_map[0],          power_up_map[1] },
+	{ explosion_2x2_map[0][0],  explosion_2x2_map[1][0] },
+	{ explosion_3x2_map[0][0],  explosion_3x2_map[1][0] }
+};
+
+// Enemy animation scripts.
+// Every instruction is an opcode followed by a one byte argument. The
+// script runs until it hits an instruction which yields (A_WAIT,
+// A_RANDOM, A_DIE, A_DROP), and is not looked at again until the wait
+// is over. A_GOTO and A_LOOP take the index of an instruction, not a
+// byte offset.
+typedef enum {
+	A_FRAME,	// Draw a frame from anim_frames[]
+	A_DELTA,	// Redraw changed cells from anim_deltas[]
+	A_SHIFT,	// Draw a pre-shifted frame from anim_shifts[]
+	A_TILE,		// Set the single tile at the enemy's position
+	A_CLEAR,	// Blank a SIZE(w,h) box at the enemy's position
+	A_ICON,		// Draw the power-up icon
+	A_BEAM,		// Eyeball beam, BEAM_FIRE/BEAM_FLASH/BEAM_OFF
+	A_MOVE,		// Move by MOVE(dx,dy)
+	A_SPAWN,	// Add an enemy of the given ID at our position
+	A_FLAGS,	// Set enemy flags
+	A_SHOOT,	// Fire a shot at the ship
+	A_WAIT,		// Wait n frames
+	A_RANDOM,	// Wait 1-n frames
+	A_COUNT,	// Set the loop counter
+	A_LOOP,		// Decrement the loop counter, jump if not zero
+	A_GOTO,		// Jump to instruction
+	A_DIE,		// Remove the enemy
+	A_DROP		// Turn into a power-up every now and then, else die
+} anim_op_t;
+
+#define MOVE(dx,dy) ((((dx)&0x0f)<<4)|((dy)&0x0f))
+#define SIZE(w,h)   (((w)<<4)|(h))
+
+#define BEAM_OFF   0
+#define BEAM_FIRE  1		// Draw the beam
+#define BEAM_FLASH 2		// Swap its colours over
+
+const unsigned char mine_script[] PROGMEM = {
+	A_FRAME,	FRAME_MINE,
+	A_WAIT,		30,
+	A_DELTA,	DELTA_MINE_0_1,		// 2
+	A_WAIT,		30,
+	A_DELTA,	DELTA_MINE_1_0,
+	A_WAIT,		30,
+	A_GOTO,		2
+};
 
-const char hornet_map[2][6] PROGMEM = {
-	{ 2,2,	101,102,
-			117,118 },
-	{ 2,2,	103,104,
-			119,120 }
+const unsigned char mortar_launcher_script[] PROGMEM = {
+	A_FRAME,	FRAME_MORTAR_LAUNCHER,
+	A_SPAWN,	ENEMY_MORTAR,
+	A_WAIT,		90,
+	A_GOTO,		0
 };
 
+const unsigned char mortar_script[] PROGMEM = {
+	A_MOVE,		MOVE(-1,-1),	// Launch from the top-left of the launcher
+	A_TILE,		MORTAR_BR,
+	A_WAIT,		4,
+	A_TILE,		MORTAR_TL,
+	A_WAIT,		3,
+	A_TILE,		0,
+	A_MOVE,		MOVE(-1,-1),
+	A_WAIT,		1,
+	A_GOTO,		1
+};
+
+const unsigned char spinner_script[] PROGMEM = {
+	A_FRAME,	FRAME_SPINNER,
+	A_WAIT,		4,				// 1
+	A_DELTA,	DELTA_SPINNER_0_1,
+	A_WAIT,		4,
+	A_DELTA,	DELTA_SPINNER_1_2,
+	A_WAIT,		4,
+	A_DELTA,	DELTA_SPINNER_2_3,
+	A_WAIT,		3,
+	A_MOVE,		MOVE(-1,0),
+	A_WAIT,		1,
+	A_DELTA,	DELTA_SPINNER_3_0_LEFT,
+	A_GOTO,		1
+};
+
+const unsigned char eyeball_script[] PROGMEM = {
+	A_FRAME,	FRAME_EYEBALL,
+	A_FLAGS,	EF_SHIELDED,
+	// Closed, for a random time.
+	A_WAIT,		250,			// 2
+	A_WAIT,		50,
+	A_RANDOM,	180,
+	// Open eye.
+	A_DELTA,	DELTA_EYEBALL_0_1,
+	A_FLAGS,	0,
+	A_WAIT,		60,
+	A_SHOOT,	0,
+	A_WAIT,		60,
+	// Fire!
+	A_BEAM,		BEAM_FIRE,
+	A_COUNT,	23,
+	A_WAIT,		5,				// 12
+	A_BEAM,		BEAM_FLASH,
+	A_LOOP,		12,
+	A_WAIT,		5,
+	// Stop firing
+	A_BEAM,		BEAM_OFF,
+	A_WAIT,		120,
+	// Close again.
+	A_DELTA,	DELTA_EYEBALL_1_0,
+	A_FLAGS,	EF_SHIELDED,
+	A_GOTO,		2
+};
+
+const unsigned char tentacle_script[] PROGMEM = {
+	A_FRAME,	FRAME_TENTACLE,
+	A_DIE,		0
+};
+
+const unsigned char hornet_script[] PROGMEM = {
+	A_FRAME,	FRAME_HORNET,
+	// Hover for a second...
+	A_COUNT,	16,
+	A_WAIT,		2,				// 2
+	A_DELTA,	DELTA_HORNET_0_1,
+	A_WAIT,		2,
+	A_DELTA,	DELTA_HORNET_1_0,
+	A_LOOP,		2,
+	// ...then attack.
+	A_SHOOT,	0,
+#ifdef SHIFT_HORNET_1_4
+	// Half a column at a time, with the second frame shifted in between.
+	A_WAIT,		2,				// 8
+	A_MOVE,		MOVE(-1,0),
+	A_SHIFT,	SHIFT_HORNET_1_4,
+	A_WAIT,		2,
+	A_CLEAR,	SIZE(3,2),
+	A_FRAME,	FRAME_HORNET,
+	A_GOTO,		8
+#else
+	A_WAIT,		2,				// 8
+	A_MOVE,		MOVE(-1,0),
+	A_DELTA,	DELTA_HORNET_0_1_LEFT,
+	A_WAIT,		2,
+	A_DELTA,	DELTA_HORNET_1_0,
+	A_GOTO,		8
+#endif
+};
+
+const unsigned char power_up_script[] PROGMEM = {
+	A_FRAME,	FRAME_POWER_UP,
+	A_ICON,		0,
+	A_WAIT,		30,
+	A_GOTO,		0
+};
+
+const unsigned char explosion_2x2_script[] PROGMEM = {
+	A_FRAME,	FRAME_EXP_2X2,
+	A_WAIT,		10,
+	A_DELTA,	DELTA_EXPLOSION_2X2_0_1,
+	A_WAIT,		10,
+	A_DIE,		0
+};
+
+const unsigned char explosion_3x2_script[] PROGMEM = {
+	A_FRAME,	FRAME_EXP_3X2,
+	A_WAIT,		5,
+	A_DELTA,	DELTA_EXPLOSION_3X2_0_1,
+	A_WAIT,		5,
+	A_DELTA,	DELTA_EXPLOSION_3X2_1_2,
+	A_WAIT,		5,
+	A_CLEAR,	SIZE(3,2),
+	A_DROP,		0
+};
+
+typedef void (*enemy_handler_t)( int e );
+void run_script( int i );
+void eyeball_killed( int e );
+void update_worm( int i );
+void collect_speed( int e );
+void collect_bomb( int e );
+void collect_missile( int e );
+void fire_shot( int e );
+void spawn_debris( int e );
+void worm_erase( int e );
+
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) hp,
+const char enemy_hp[ENEMY_COUNT] PROGMEM = { ENEMY_LIST };
+#undef X
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) score,
+const int enemy_score[ENEMY_COUNT] PROGMEM = { ENEMY_LIST };
+#undef X
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) foot,
+const unsigned char enemy_footprint[ENEMY_COUNT] PROGMEM = { ENEMY_LIST };
+#undef X
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) hitbox,
+const unsigned char enemy_hitbox[ENEMY_COUNT] PROGMEM = { ENEMY_LIST };
+#undef X
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) dies,
+const unsigned char enemy_dies_as[ENEMY_COUNT] PROGMEM = { ENEMY_LIST };
+#undef X
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) prio,
+const unsigned char enemy_priority[ENEMY_COUNT] PROGMEM = { ENEMY_LIST };
+#undef X
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) script,
+const unsigned char * const enemy_script[ENEMY_COUNT] PROGMEM = { ENEMY_LIST };
+#undef X
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) update,
+const enemy_handler_t enemy_update[ENEMY_COUNT] PROGMEM = { ENEMY_LIST };
+#undef X
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) killed,
+const enemy_handler_t enemy_killed[ENEMY_COUNT] PROGMEM = { ENEMY_LIST };
+#undef X
+#define X(id,hp,score,foot,hitbox,dies,prio,script,update,killed,erase) erase,
+const enemy_handler_t enemy_erase[ENEMY_COUNT] PROGMEM = { ENEMY_LIST };
+#undef X
+
 
 const char title_map[82] PROGMEM = {
 	16,5,	7,0,7,0, 6,6,6, 2,0,1, 6,6,2, 1,6,2,
@@ -257,59 +525,54 @@ const char title_map[82] PROGMEM = {
 #define COL_RIGHT   0x05
 #define COL_TOP     0x0c
 #define COL_BOTTOM  0x03
-const unsigned char sprite_col_map[] PROGMEM = {
-	0x00, 0x02, 0x0c, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-	0x00, 0x0f, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x02, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x0f, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f
+// sprite_col_map[] and bg_col_map[] are generated from the .col files, as
+// are the 2x2 pixel masks used with COL_FINE.
+
+#if COL_FINE
+// A row of four cells moved right by 0-4 cells, across two tiles: the
+// left tile's part in the high nibble and the right's in the low one.
+const unsigned char col_row_shift[16][5] PROGMEM = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 },
+	{ 0x10, 0x08, 0x04, 0x02, 0x01 },
+	{ 0x20, 0x10, 0x08, 0x04, 0x02 },
+	{ 0x30, 0x18, 0x0c, 0x06, 0x03 },
+	{ 0x40, 0x20, 0x10, 0x08, 0x04 },
+	{ 0x50, 0x28, 0x14, 0x0a, 0x05 },
+	{ 0x60, 0x30, 0x18, 0x0c, 0x06 },
+	{ 0x70, 0x38, 0x1c, 0x0e, 0x07 },
+	{ 0x80, 0x40, 0x20, 0x10, 0x08 },
+	{ 0x90, 0x48, 0x24, 0x12, 0x09 },
+	{ 0xa0, 0x50, 0x28, 0x14, 0x0a },
+	{ 0xb0, 0x58, 0x2c, 0x16, 0x0b },
+	{ 0xc0, 0x60, 0x30, 0x18, 0x0c },
+	{ 0xd0, 0x68, 0x34, 0x1a, 0x0d },
+	{ 0xe0, 0x70, 0x38, 0x1c, 0x0e },
+	{ 0xf0, 0x78, 0x3c, 0x1e, 0x0f }
 };
-const unsigned char bg_col_map[2][TILES_PER_SET+64] PROGMEM = {
-	{
-		0x00, 0x07, 0x0b, 0x0d, 0x0e, 0x0f, 0x0f, 0x0f,   0x07, 0x0f, 0x07, 0x0b, 0x0f, 0x0f, 0x06, 0x09,
-		0x01, 0x0f, 0x0e, 0x07, 0x0f, 0x0b, 0x0f, 0x0f,   0x03, 0x03, 0x03, 0x07, 0x0b, 0x0f, 0x07, 0x0b,
-		0x07, 0x0f, 0x02, 0x0d, 0x0f, 0x0e, 0x0f, 0x0f,   0x0f, 0x0f, 0x0f, 0x0d, 0x0e, 0x0f, 0x0d, 0x0e,
-		0x05, 0x00, 0x0f, 0x0f, 0x0f, 0x0f, 0x04, 0x08,   0x0c, 0x0c, 0x0c, 0x00, 0x00, 0x00, 0x0d, 0x0f,
-
-		0x0f, 0x0f, 0x0f, 0x0f, 0x00, 0x03, 0x0f, 0x01,   0x07, 0x0f, 0x05, 0x07, 0x0a, 0x03, 0x0f, 0x00,
-		0x0f, 0x0f, 0x0f, 0x0f, 0x00, 0x0c, 0x0f, 0x0f,   0x0d, 0x0f, 0x05, 0x0f, 0x0a, 0x0c, 0x0f, 0x00,
-		0x0f, 0x0f, 0x0f, 0x0f, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x01, 0x00, 0x08, 0x0f, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-
-		0x05, 0x0f, 0x01, 0x0f, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x0f, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x0f, 0x0f, 0x00, 0x00,
-		
-		// Overlay
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0f, 0x0f,   0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x00, 0x00,		
-	},
-	{
-		// Overlay
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0f, 0x0f,   0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x00, 0x00,
-
-		// BG Tiles
-		0x0f, 0x0f, 0x01, 0x02, 0x0f, 0x0f, 0x0f, 0x02,   0x0f, 0x0f, 0x0f, 0x0f, 0x01, 0x01, 0x0f, 0x02,
-		0x0f, 0x0f, 0x0f, 0x0f, 0x00, 0x00, 0x00, 0x00,   0x00, 0x04, 0x08, 0x0f, 0x05, 0x0f, 0x0f, 0x0f,
-		0x0f, 0x0f, 0x0f, 0x0f, 0x00, 0x00, 0x00, 0x00,   0x00, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x0b, 0x05,   0x0b, 0x00, 0x00, 0x00, 0x0f, 0x0f, 0x0f, 0x0f,		
-
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,		
-
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00
-	}
+#else
+// A sprite's quadrants spread over the 2x2 grid of tiles under it (see
+// col_check), by how far it is into the top-left tile: none, partly, or
+// more than half way, down then across.
+#define COL_OFFSET(o) ( (o) > 3 ? 2 : (o) ? 1 : 0 )
+const unsigned int sprite_col_shift[16][3][3] PROGMEM = {
+	{ { 0x0000, 0x0000, 0x0000 }, { 0x0000, 0x0000, 0x0000 }, { 0x0000, 0x0000, 0x0000 } },
+	{ { 0x1000, 0x1200, 0x0300 }, { 0x1040, 0x1248, 0x030c }, { 0x0050, 0x005a, 0x000f } },
+	{ { 0x2000, 0x3000, 0x1200 }, { 0x2080, 0x30c0, 0x1248 }, { 0x00a0, 0x00f0, 0x005a } },
+	{ { 0x3000, 0x3200, 0x1300 }, { 0x30c0, 0x32c8, 0x134c }, { 0x00f0, 0x00fa, 0x005f } },
+	{ { 0x4000, 0x4800, 0x0c00 }, { 0x5000, 0x5a00, 0x0f00 }, { 0x1040, 0x1248, 0x030c } },
+	{ { 0x5000, 0x5a00, 0x0f00 }, { 0x5040, 0x5a48, 0x0f0c }, { 0x1050, 0x125a, 0x030f } },
+	{ { 0x6000, 0x7800, 0x1e00 }, { 0x7080, 0x7ac0, 0x1f48 }, { 0x10e0, 0x12f8, 0x035e } },
+	{ { 0x7000, 0x7a00, 0x1f00 }, { 0x70c0, 0x7ac8, 0x1f4c }, { 0x10f0, 0x12fa, 0x035f } },
+	{ { 0x8000, 0xc000, 0x4800 }, { 0xa000, 0xf000, 0x5a00 }, { 0x2080, 0x30c0, 0x1248 } },
+	{ { 0x9000, 0xd200, 0x4b00 }, { 0xb040, 0xf248, 0x5b0c }, { 0x20d0, 0x30da, 0x124f } },
+	{ { 0xa000, 0xf000, 0x5a00 }, { 0xa080, 0xf0c0, 0x5a48 }, { 0x20a0, 0x30f0, 0x125a } },
+	{ { 0xb000, 0xf200, 0x5b00 }, { 0xb0c0, 0xf2c8, 0x5b4c }, { 0x20f0, 0x30fa, 0x125f } },
+	{ { 0xc000, 0xc800, 0x4c00 }, { 0xf000, 0xfa00, 0x5f00 }, { 0x30c0, 0x32c8, 0x134c } },
+	{ { 0xd000, 0xda00, 0x4f00 }, { 0xf040, 0xfa48, 0x5f0c }, { 0x30d0, 0x32da, 0x134f } },
+	{ { 0xe000, 0xf800, 0x5e00 }, { 0xf080, 0xfac0, 0x5f48 }, { 0x30e0, 0x32f8, 0x135e } },
+	{ { 0xf000, 0xfa00, 0x5f00 }, { 0xf0c0, 0xfac8, 0x5f4c }, { 0x30f0, 0x32fa, 0x135f } }
 };
+#endif
 
 #define TITLE_SECONDS   10
 #define HISCORE_SECONDS	10
@@ -341,8 +604,17 @@ typedef struct {
 	char y_vol;
 	char status;
 	int anim_step;
+	unsigned char missiles;		// Left to launch
 } ship_t;
 #define SPRITE_SHIP      0
+#define SHIP_RAM_TILES   10		// Most it can cover, unaligned
+
+// Enemy shots have their own sprites, straight after the ship's, so that
+// the kernel gives them ram tiles before anything else. No more are fired
+// than are sure to get them, see init_anim_tiles().
+#define SPRITE_SHOT1     4
+#define MAX_SHOTS        2
+#define SHOT_RAM_TILES   4
 
 typedef enum {
 	BULLET_FREE = 0,
@@ -357,7 +629,7 @@ typedef struct {
 	unsigned char y;
 	char status;
 } bullet_t;
-#define SPRITE_BULLET1  4
+#define SPRITE_BULLET1  (SPRITE_SHOT1+MAX_SHOTS)
 #define MAX_BULLETS     6
 #define BULLET_SPEED    4
 #define BULLET_DELAY    ((SCREEN_TILES_H*8)/BULLET_SPEED/(MAX_BULLETS-1))
@@ -365,12 +637,183 @@ typedef struct {
 #define SPRITE_WHOOSH (SPRITE_BULLET1+MAX_BULLETS)
 #define WHOOSH_SPRITES  8
 
+// Enemies which move freely are drawn with sprites rather than into vram,
+// and hit-tested by comparing boxes in screen pixels.
+typedef enum {
+	ALIEN_FREE = 0,
+	ALIEN_FLYING,
+	ALIEN_EXPLODING
+} alien_status_t;
+
+typedef struct {
+	unsigned char x;
+	unsigned char y;		// Centre line of its wave
+	char hp;
+	unsigned char step;		// Frames flown, or left to explode
+	char status;
+	char sprite;			// In mux[]
+} alien_t;
+#define MAX_ALIENS      2
+#define ALIEN_W         16
+#define ALIEN_H         8
+#define ALIEN_EXPLODE   16
+
+// The sprites after the whoosh are shared out each frame by mux_update()
+// among any number of objects, highest priority first. Each object is one
+// sprite, or two side by side. Those which don't get sprites take turns,
+// flickering rather than vanishing, so anything they hit must be tested
+// against mux[] or their owner's position, not sprites[].
+#define SPRITE_MUX1     (SPRITE_WHOOSH+WHOOSH_SPRITES)
+#define MUX_SPRITES     (MAX_SPRITES-SPRITE_MUX1)
+#define MAX_MUX         16
+
+typedef struct {
+	unsigned char x;
+	unsigned char y;
+	unsigned char tile;		// 0 if free
+	unsigned char tile2;	// To the right of tile, or 0 if none
+	unsigned char prio;		// PRIO_COSMETIC, PRIO_NORMAL or PRIO_HIGH
+} mux_t;
+
+#if MUX_SPRITES < 2
+#error Not enough sprites left to share out, raise MAX_SPRITES.
+#endif
+
+// Homing missiles go with each shot while the ship has any. They move in
+// 1/16ths of a pixel, steering a little towards their target each frame,
+// but only one a frame looks for a new target.
+#define MAX_MISSILES    4
+#define MISSILE_AMMO    12
+#define MISSILE_MAX     24
+#define MISSILE_TILE    12
+#define MISSILE_SPEED   48		// 3 pixels a frame
+#define MISSILE_TURN    6
+#define MISSILE_DAMAGE  BULLET_MEDIUM
+#define FIX(p)          ((p) << 4)
+#define UNFIX(f)        ((f) >> 4)
+
+typedef struct {
+	int x;					// On screen, fixed point
+	int y;
+	char dx;
+	char dy;
+	char target;			// Enemy, or -1
+	char sprite;			// In mux[], or -1 if free
+} missile_t;
+
+// Enemy shots fly straight at where the ship was when they were fired.
+// Their step comes from shot_aim[], so aiming needs no divides or trig.
+#define SHOT_TILE       15
+#define SHOT_SPEED      24		// 1.5 pixels a frame, as in shot_aim[]
+#define SHOT_AIM_STEPS  16		// Across and down shot_aim[]
+
+typedef struct {
+	int x;					// On screen, fixed point
+	int y;
+	char dx;
+	char dy;
+	bool live;
+} shot_t;
+
+// Step of a shot fired at a target x,y pixels away, both scaled down to
+// fit, as SHOT_SPEED * (x,y) / |(x,y)|. Signs are put back afterwards.
+const char shot_aim[SHOT_AIM_STEPS][SHOT_AIM_STEPS][2] PROGMEM = {
+	{ {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0}, {24, 0} },
+	{ { 0,24}, {17,17}, {21,11}, {23, 8}, {23, 6}, {24, 5}, {24, 4}, {24, 3}, {24, 3}, {24, 3}, {24, 2}, {24, 2}, {24, 2}, {24, 2}, {24, 2}, {24, 2} },
+	{ { 0,24}, {11,21}, {17,17}, {20,13}, {21,11}, {22, 9}, {23, 8}, {23, 7}, {23, 6}, {23, 5}, {24, 5}, {24, 4}, {24, 4}, {24, 4}, {24, 3}, {24, 3} },
+	{ { 0,24}, { 8,23}, {13,20}, {17,17}, {19,14}, {21,12}, {21,11}, {22, 9}, {22, 8}, {23, 8}, {23, 7}, {23, 6}, {23, 6}, {23, 5}, {23, 5}, {24, 5} },
+	{ { 0,24}, { 6,23}, {11,21}, {14,19}, {17,17}, {19,15}, {20,13}, {21,12}, {21,11}, {22,10}, {22, 9}, {23, 8}, {23, 8}, {23, 7}, {23, 7}, {23, 6} },
+	{ { 0,24}, { 5,24}, { 9,22}, {12,21}, {15,19}, {17,17}, {18,15}, {20,14}, {20,13}, {21,12}, {21,11}, {22,10}, {22, 9}, {22, 9}, {23, 8}, {23, 8} },
+	{ { 0,24}, { 4,24}, { 8,23}, {11,21}, {13,20}, {15,18}, {17,17}, {18,16}, {19,14}, {20,13}, {21,12}, {21,11}, {21,11}, {22,10}, {22, 9}, {22, 9} },
+	{ { 0,24}, { 3,24}, { 7,23}, { 9,22}, {12,21}, {14,20}, {16,18}, {17,17}, {18,16}, {19,15}, {20,14}, {20,13}, {21,12}, {21,11}, {21,11}, {22,10} },
+	{ { 0,24}, { 3,24}, { 6,23}, { 8,22}, {11,21}, {13,20}, {14,19}, {16,18}, {17,17}, {18,16}, {19,15}, {19,14}, {20,13}, {20,13}, {21,12}, {21,11} },
+	{ { 0,24}, { 3,24}, { 5,23}, { 8,23}, {10,22}, {12,21}, {13,20}, {15,19}, {16,18}, {17,17}, {18,16}, {19,15}, {19,14}, {20,14}, {20,13}, {21,12} },
+	{ { 0,24}, { 2,24}, { 5,24}, { 7,23}, { 9,22}, {11,21}, {12,21}, {14,20}, {15,19}, {16,18}, {17,17}, {18,16}, {18,15}, {19,15}, {20,14}, {20,13} },
+	{ { 0,24}, { 2,24}, { 4,24}, { 6,23}, { 8,23}, {10,22}, {11,21}, {13,20}, {14,19}, {15,19}, {16,18}, {17,17}, {18,16}, {18,16}, {19,15}, {19,14} },
+	{ { 0,24}, { 2,24}, { 4,24}, { 6,23}, { 8,23}, { 9,22}, {11,21}, {12,21}, {13,20}, {14,19}, {15,18}, {16,18}, {17,17}, {18,16}, {18,16}, {19,15} },
+	{ { 0,24}, { 2,24}, { 4,24}, { 5,23}, { 7,23}, { 9,22}, {10,22}, {11,21}, {13,20}, {14,20}, {15,19}, {16,18}, {16,18}, {17,17}, {18,16}, {18,16} },
+	{ { 0,24}, { 2,24}, { 3,24}, { 5,23}, { 7,23}, { 8,23}, { 9,22}, {11,21}, {12,21}, {13,20}, {14,20}, {15,19}, {16,18}, {16,18}, {17,17}, {18,16} },
+	{ { 0,24}, { 2,24}, { 3,24}, { 5,24}, { 6,23}, { 8,23}, { 9,22}, {10,22}, {11,21}, {12,21}, {13,20}, {14,19}, {15,19}, {16,18}, {16,18}, {17,17} }
+};
+
+// Kills throw out a few shards of debris, drawn with spare sprites. It's
+// only for show, so no more than DEBRIS_BUDGET pieces are started a frame,
+// none at all while vram is behind, and they're the first to go without a
+// sprite.
+#define MAX_DEBRIS      8
+#define DEBRIS_PIECES   4		// For each kill
+#define DEBRIS_BUDGET   4		// Started a frame
+#define DEBRIS_LIFE     24		// Frames
+#define DEBRIS_TILE     36		// First of four shards
+#define DEBRIS_GRAVITY  2
+#define DEBRIS_BUSY     (VRAM_QUEUE/4)	// Queued vram writes
+
+typedef struct {
+	int x;					// On screen, fixed point
+	int y;
+	char dx;
+	char dy;
+	unsigned char life;
+	char sprite;			// In mux[], or -1 if free
+} debris_t;
+
+// Directions to throw debris in, a little upwards, fixed point.
+const char debris_spray[8][2] PROGMEM = {
+	{ 24,-8 }, { 17,-25 }, { 0,-32 }, { -17,-25 },
+	{ -24,-8 }, { -17,9 }, { 0,12 }, { 17,9 }
+};
+
+// Bullets are tested against the tiles a sprite at a time. The last result
+// for each is kept until the sprite moves or changes, or vram does.
+typedef struct {
+	unsigned char x;		// Pixel position on vram
+	unsigned char y;
+	unsigned char tile;		// Sprite's tileIndex, 0 if none
+	unsigned char gen;		// vram_gen when tested
+	unsigned int map;
+} col_cache_t;
+
+// The ship and whoosh are each a group of sprites, moved together and
+// tested against the tiles as one. Their collision mask is built from the
+// parts' own whenever the map changes, and the last result is kept in the
+// same way as col_cache.
+#define META_MAX_W  4			// Tiles
+#define META_MAX_H  2
+#define META_BITS   (META_MAX_W*COL_CELLS)
+#define META_SOLID  0x01		// Has anything to collide with
+#define META_STALE  0x02		// Mask changed since the last test
+
+typedef struct {
+	unsigned char first;		// Sprite of the first part
+	unsigned char parts;
+	unsigned char flags;
+	unsigned char x;			// Origin, on screen
+	unsigned char y;
+	const char *layout;
+	unsigned int rows[META_MAX_H*COL_CELLS];	// A row of cells each, left in the MSB
+	unsigned char col_x;		// Last test, as in col_cache_t
+	unsigned char col_y;
+	unsigned char col_gen;
+	unsigned int hits;
+} metasprite_t;
+
+#if META_BITS > 16
+#error Metasprite mask rows must fit an unsigned int.
+#endif
+
 #define MAX_LIVES 9
 
 // Globals
 unsigned int frame;
 ship_t ship;
 bullet_t bullet[MAX_BULLETS];
+missile_t missile[MAX_MISSILES];
+unsigned char missile_turn;		// The one to look for a target
+shot_t shot[MAX_SHOTS];
+unsigned char shot_limit;		// Shots which are sure to be drawn
+debris_t debris[MAX_DEBRIS];
+unsigned char debris_budget;	// Pieces which can still be started this frame
+alien_t alien[MAX_ALIENS];
 char bullet_charge;
 char level;
 unsigned long score;
@@ -380,10 +823,21 @@ unsigned char *level_prev_column;
 char level_vram_column;
 char level_col_repeat;
 int level_column;
+int camera_column;
+volatile unsigned char vram_gen;	// Bumped whenever vram's playfield tiles change
+col_cache_t col_cache[MAX_BULLETS];
+metasprite_t ship_meta = { SPRITE_SHIP };
+mux_t mux[MAX_MUX];
+unsigned char mux_turn;		// Where to start sharing out, to take turns
+metasprite_t whoosh_meta = { SPRITE_WHOOSH };
 char scroll_speed;
 char scroll_countdown;
 enemy_def_t *enemy_pos;
-enemy_t enemies[MAX_ENEMIES];
+enemy_pool_t enemies;
+unsigned char enemy_active[MAX_ENEMIES];
+unsigned char enemy_count;
+unsigned char enemy_free[MAX_ENEMIES];
+unsigned char enemy_free_count;
 int overlay_offset;
 int tileset;
 bool alive;
@@ -401,6 +855,17 @@ char hi_name[HIGH_SCORES][4]        = { "SAM\0","TOM\0","UZE\0","TUX\0","JIM\0",
 unsigned long hi_score[HIGH_SCORES] = {  100000, 90000,  80000,  70000,  60000,  50000,  40000,  30000  };
 
 
+// Enemies are placed by level column. The camera is the level column at
+// the left of the screen, and the VRAM_TILES_H columns from there are the
+// ones held in vram, where level column c is always at VRAM_X(c).
+#if VRAM_TILES_H & (VRAM_TILES_H-1)
+#error VRAM_TILES_H must be a power of two.
+#endif
+#define VRAM_X(c)     ((level_vram_column + (c) - level_column) & (VRAM_TILES_H-1))
+#define LEVEL_X(v)    (camera_column + (((v) - VRAM_X(camera_column)) & (VRAM_TILES_H-1)))
+#define IN_VIEW(c)    ((unsigned int)((c) - camera_column) < VRAM_TILES_H)
+#define CAMERA_MARGIN 4		// Columns an enemy may hang off the left
+
 void set_tiles( int level ) {
 	if( level < 3 ) {
 		SetTileTable(tiles1);
@@ -408,895 +873,2221 @@ void set_tiles( int level ) {
 		overlay_offset = TILES_PER_SET;
 	}
 	else {
-		SetTileTable(overlay_tiles);
+		SetTileTable(tiles2);
 		tileset = 1;
-		overlay_offset = 0;
+		overlay_offset = TILESET1_OVERLAY;
 	}
+	vram_gen++;
 }
 
-int add_enemy( enemy_id_t id, int x, int y ) {
-	int i;
-	for( i=0 ; i < MAX_ENEMIES ; i++ ) {
-		if( enemies[i].id == ENEMY_NONE ) {
-			enemies[i].id = id;
-			enemies[i].x = x;
-			enemies[i].y = y;
-			enemies[i].hp = pgm_read_byte( &enemy_hp[id] );
-			enemies[i].whooshed = 0;
-			enemies[i].anim_step = 0;
-			if( id == ENEMY_EYEBALL ) {
-				boss_enemies++;
-			}
-			return i;
-		}
-	}
-	return -1;
+unsigned char anim_col[ANIM_TILES];		// Collision bitmaps of all they may show
+#if COL_FINE
+unsigned int anim_fine[ANIM_TILES];
+#endif
+
+void set_anim_tile( unsigned char a, unsigned char t ) {
+	CopyTileToRam( t, a );
+	vram_gen++;
+#if COL_FINE
+	anim_fine[a] = pgm_read_word( &bg_col_fine[tileset][t] );
+#endif
 }
 
-void level_draw_column( void ) {
-	int y = 0;
-	int c = 0;
-	unsigned char *p = level_pos;
-	static int r = 22;
+// How many animated tiles each set uses.
+const unsigned char anim_tiles[2] PROGMEM = { 4, 1 };
 
-	if( scroll_countdown )
-		return;
+// The tiles each animated tile switches between, per tile set.
+const unsigned char anim_shows[2][ANIM_TILES][2] PROGMEM = {
+	{
+		{ 52, 53 },				// ANIM_BEAM_TOP
+		{ 52, 53 },				// ANIM_BEAM_BOTTOM
+		{ 50, 51 },				// ANIM_TENTACLE_A
+		{ 50, 51 }				// ANIM_TENTACLE_B
+	},
+	{
+		{ LAVA_TILE, LAVA_TILE }	// ANIM_LAVA
+	}
+};
 
-	if( level_col_repeat ) {
-		// Copy previous column.
-		p = level_prev_column;
+void init_anim_tiles( void ) {
+	unsigned char a;
+
+	// col_plane holds a cell's bitmap from when it was drawn, so give the
+	// animated tiles one which covers every frame.
+	for( a=0 ; a<ANIM_TILES ; a++ ) {
+		anim_col[a] = pgm_read_byte( &bg_col_map[tileset][pgm_read_byte( &anim_shows[tileset][a][0] )] )
+		            | pgm_read_byte( &bg_col_map[tileset][pgm_read_byte( &anim_shows[tileset][a][1] )] );
+	}
+
+	SetUserRamTilesCount( pgm_read_byte( &anim_tiles[tileset] ) );
+	shot_limit = (RAM_TILES_COUNT - pgm_read_byte( &anim_tiles[tileset] ) - SHIP_RAM_TILES) / SHOT_RAM_TILES;
+	if( shot_limit > MAX_SHOTS ) {
+		shot_limit = MAX_SHOTS;
+	}
+	if( tileset == 0 ) {
+		set_anim_tile( ANIM_TENTACLE_A, 50 );
+		set_anim_tile( ANIM_TENTACLE_B, 51 );
 	}
 	else {
-		if( pgm_read_byte(p) == 0xff ) {
-			// Magic...
-			p++;
-			if( pgm_read_byte(p) == 0xff ) {
-				// End of level
-				scroll_countdown = 24;
-				while( pgm_read_byte( &enemy_pos->id ) != ENEMY_NONE ) {
-					while( pgm_read_byte( &enemy_pos->x ) == level_column-3 ) {
-							add_enemy( pgm_read_byte( &enemy_pos->id ), level_vram_column-3, pgm_read_byte( &enemy_pos->y ) );
-							enemy_pos++;
-					}
-					level_column++;
-					level_vram_column++;
-					if( level_vram_column >= VRAM_TILES_H ) {
-						level_vram_column = 0;
-					}
-				}
-				return;
-			}
-			else {
-				// Repeat previous column
-				level_col_repeat = pgm_read_byte(p);
-				level_pos += 2;
-				p = level_prev_column;
+		set_anim_tile( ANIM_LAVA, LAVA_TILE );
+	}
+}
+
+void update_anim_tiles( void ) {
+	unsigned char *p;
+	unsigned char x, y, c;
+
+	if( tileset == 0 ) {
+		if( frame % TENTACLE_FRAMES == 0 ) {
+			set_anim_tile( ANIM_TENTACLE_A, frame % (TENTACLE_FRAMES*2) ? 51 : 50 );
+			set_anim_tile( ANIM_TENTACLE_B, frame % (TENTACLE_FRAMES*2) ? 50 : 51 );
+		}
+	}
+	else if( frame % LAVA_FRAMES == 0 ) {
+		// Lava flows, each row of pixels going round one to the right.
+		p = GetUserRamTile( ANIM_LAVA );
+		for( y=0 ; y<TILE_HEIGHT ; y++ ) {
+			c = p[TILE_WIDTH-1];
+			for( x=TILE_WIDTH-1 ; x>0 ; x-- ) {
+				p[x] = p[x-1];
 			}
+			p[0] = c;
+			p += TILE_WIDTH;
 		}
 	}
+}
 
-	// Draw the actual column.
-	while( y<LEVEL_TILES_Y ) {
-		if( pgm_read_byte(p) == 0xff ) {
-			// Repeat previous tile
-			unsigned char t = pgm_read_byte(p-1);
-			p++;
-			for( c=pgm_read_byte(p) ; c>0 ; c-- ) {
-				if( t == 0 && r <= 0 ) {
-					// Random background filler
-					SetTile(level_vram_column,y,pgm_read_byte(&random_tiles[(int)level][random()%3]));
-					r = (random()%VRAM_TILES_H) + 1;
-				}
-				else {
-					SetTile(level_vram_column,y,t);
-					r--;
-				}
-				y++;
+// Collision bitmap of whatever a vram cell shows.
+unsigned char tile_col( unsigned char v ) {
+	if( v >= RAM_TILES_COUNT ) {
+		return pgm_read_byte( &bg_col_map[tileset][v-RAM_TILES_COUNT] );
+	}
+	return v < pgm_read_byte( &anim_tiles[tileset] ) ? anim_col[v] : 0;
+}
+
+// Collision bitmaps of the playfield, two cells to a byte with the even
+// column in the high nibble. Kept in step with vram by put_tile().
+unsigned char col_plane[LEVEL_TILES_Y][VRAM_TILES_H/2];
+#define PLANE_COL(row,v) ( ((v) & 1) ? (row)[(v)/2] & 0x0f : (row)[(v)/2] >> 4 )
+#define PLANE_SET(row,v,c) \
+	( (row)[(v)/2] = ((v) & 1) ? ((row)[(v)/2] & 0xf0) | (c) : ((row)[(v)/2] & 0x0f) | ((c) << 4) )
+
+// Changes to what's in view are queued and made in the vsync interrupt,
+// so they never show half done, up to VRAM_BUDGET tiles a frame. The
+// collision plane is updated straight away, and vram_gen again once vram
+// has caught up. Anything needing a cell's tile before then gets it from
+// queued_tile(). The HUD is kept in hud[] and copied over when there's
+// budget to spare.
+#define VRAM_QUEUE  32			// Power of two
+#define VRAM_BUDGET 64
+
+typedef struct {
+	unsigned char v;			// Vram column
+	unsigned char y;
+	unsigned char n;			// Never more than VRAM_TILES_H
+	unsigned char t;			// Vram value, if no map
+	const char *map;			// PROGMEM tiles, 0 leaving a cell alone
+} vram_cmd_t;
+
+volatile vram_cmd_t vram_queue[VRAM_QUEUE];
+volatile unsigned char vram_head;	// Next to add
+volatile unsigned char vram_tail;	// Next to write
+volatile bool vram_busy;		// vram_sync() is writing the queue
+unsigned char hud[OVERLAY_LINES][VRAM_TILES_H];
+volatile unsigned char hud_dirty;	// A bit for each row
+
+#if VRAM_BUDGET < VRAM_TILES_H || VRAM_BUDGET > 255
+#error VRAM_BUDGET must fit a whole row and a byte.
+#endif
+
+void write_run( unsigned char v, unsigned char y, unsigned char n, const char *map, unsigned char t ) {
+	unsigned char *p = &vram[(y*VRAM_TILES_H) + v];
+
+	for( ; n ; n--, p++ ) {
+		if( map ) {
+			t = pgm_read_byte(map++);
+			if( t == 0 ) {
+				continue;
 			}
-			p++;
-		}
-		else {
-			SetTile(level_vram_column,y,pgm_read_byte(p));
-			p++;
-			y++;
+			t += RAM_TILES_COUNT;
 		}
+		*p = t;
 	}
+}
 
-	// Any new enemies?
-	while( pgm_read_byte( &enemy_pos->x ) == level_column-3 ) {
-		add_enemy( pgm_read_byte( &enemy_pos->id ), level_vram_column-3, pgm_read_byte( &enemy_pos->y ) );
-		enemy_pos++;
+// Write everything queued to vram now, rather than waiting for vsync.
+void vram_sync( void ) {
+	volatile vram_cmd_t *c;
+
+	vram_busy = true;
+	while( vram_tail != vram_head ) {
+		c = &vram_queue[vram_tail];
+		write_run( c->v, c->y, c->n, c->map, c->t );
+		vram_tail = (vram_tail+1) & (VRAM_QUEUE-1);
 	}
+	vram_gen++;
+	vram_busy = false;
+}
 
-	if( level_col_repeat ) {
-		level_col_repeat--;
+void queue_run( unsigned char v, unsigned char y, unsigned char n, const char *map, unsigned char t ) {
+	unsigned char next = (vram_head+1) & (VRAM_QUEUE-1);
+	volatile vram_cmd_t *c = &vram_queue[vram_head];
+
+	// If it's full, catch up now rather than stall until vsync.
+	if( next == vram_tail ) {
+		vram_sync();
 	}
-	else {
-		level_prev_column = level_pos;
-		level_pos = p;
+
+	c->v = v;
+	c->y = y;
+	c->n = n;
+	c->t = t;
+	c->map = map;
+	vram_head = next;
+}
+
+// Pre-vsync callback.
+void vram_flush( void ) {
+	unsigned char budget = VRAM_BUDGET;
+	unsigned char y;
+	volatile vram_cmd_t *c;
+
+	while( !vram_busy && vram_tail != vram_head ) {
+		c = &vram_queue[vram_tail];
+		if( c->n > budget ) {
+			break;
+		}
+		budget -= c->n;
+		write_run( c->v, c->y, c->n, c->map, c->t );
+		vram_tail = (vram_tail+1) & (VRAM_QUEUE-1);
+	}
+	if( budget != VRAM_BUDGET ) {
+		vram_gen++;
 	}
 
-	level_column++;	
-	level_vram_column++;
-	if( level_vram_column >= VRAM_TILES_H ) {
-		level_vram_column = 0;
+	// The HUD can slip to a quieter frame.
+	for( y=0 ; y<OVERLAY_LINES ; y++ ) {
+		if( (hud_dirty & (1<<y)) && budget >= VRAM_TILES_H ) {
+			memcpy( &vram[VRAM_TILES_H*(VRAM_TILES_V+y)], hud[y], VRAM_TILES_H );
+			hud_dirty &= ~(1<<y);
+			budget -= VRAM_TILES_H;
+		}
 	}
 }
 
-void scroll( void ) {
-	static char wait = 0;
-
-	if( scroll_speed ) {
-		wait--;
-		if( wait <= 0 ) {
-			Scroll(1,0);
-			if( Screen.scrollX % 8 == 0 ) {
-				level_draw_column();
+// What a playfield cell will show once the queue has been written.
+unsigned char queued_tile( unsigned char v, unsigned char y ) {
+	unsigned char i = vram_head;
+	unsigned char tail = vram_tail;
+	volatile vram_cmd_t *c;
+
+	// Newest first, as later writes win.
+	while( i != tail ) {
+		i = (i-1) & (VRAM_QUEUE-1);
+		c = &vram_queue[i];
+		if( c->y == y && (unsigned char)(v - c->v) < c->n ) {
+			if( c->map == NULL ) {
+				return c->t;
 			}
-			wait = scroll_speed;
-			if( scroll_countdown ) {
-				scroll_countdown--;
-				if( scroll_countdown == 0 ) {
-					scroll_speed = 0;
-				}
+			if( pgm_read_byte( &c->map[v - c->v] ) ) {
+				return pgm_read_byte( &c->map[v - c->v] ) + RAM_TILES_COUNT;
 			}
 		}
 	}
+	return vram[(y*VRAM_TILES_H) + v];
 }
 
-void clear_sprites( void ) {
-	int i;
-	for( i=0 ; i < MAX_SPRITES ; i++ ) {
-		sprites[i].tileIndex = 0;
+void hud_put( unsigned char x, unsigned char y, unsigned char t ) {
+	hud[y][x] = t;
+	hud_dirty |= 1<<y;
+}
+
+// Write a vram value straight to the playfield, for cells out of view.
+void put_tile( unsigned char v, unsigned char y, unsigned char t ) {
+	vram[(y*VRAM_TILES_H) + v] = t;
+	if( y < LEVEL_TILES_Y ) {
+		PLANE_SET( col_plane[y], v, tile_col( t ) );
 	}
 }
 
-void set_bullet( int b, bullet_status_t status ) {
-	switch( status ) {
-		case BULLET_FREE:
-			sprites[SPRITE_BULLET1+b].tileIndex = 0;
-			if( bullet[b].status == BULLET_LARGE ) {
-				int i;
-				for( i=0 ; i<8 ; i++ ) {
-					sprites[SPRITE_WHOOSH+i].tileIndex = 0;
+// Queue n tiles along a row of the playfield from column v, as at most
+// two straight runs either side of the end of the vram ring. They come
+// from a map in PROGMEM, where 0 leaves a cell alone, or if map is NULL
+// are all the vram value t.
+void put_row( unsigned char v, unsigned char y, unsigned char n, const char *map, unsigned char t ) {
+	unsigned char run = VRAM_TILES_H - v;
+	unsigned char c = 0;
+	unsigned char i;
+	unsigned char m;
+
+	if( map == NULL ) {
+		c = tile_col( t );
+	}
+	if( run > n ) {
+		run = n;
+	}
+	while( n ) {
+		n -= run;
+		queue_run( v, y, run, map, t );
+		for( i=0 ; i<run ; i++, v++ ) {
+			if( map ) {
+				m = pgm_read_byte(map++);
+				if( m == 0 ) {
+					continue;
 				}
+				c = tile_col( m + RAM_TILES_COUNT );
 			}
-			break;
-		case BULLET_CHARGING:
-			sprites[SPRITE_BULLET1+b].tileIndex = 3;
-			break;
-		case BULLET_SMALL:
-			TriggerFx( SFX_FIRE, 0xff, true );
-			sprites[SPRITE_BULLET1+b].tileIndex = 2;
-			bullet[b].y++; // offset for small bullet sprite
-			bullet[b].y &= 0xfffe;
-			break;
-		case BULLET_MEDIUM:
-			TriggerFx( SFX_FIRE, 0xff, true );
-			sprites[SPRITE_BULLET1+b].tileIndex = 6;
-			bullet[b].y &= 0xfffe;
-			break;
-		case BULLET_LARGE:
-			TriggerFx( SFX_WHOOSH, 0xff, true );
-			bullet[b].y -= 4;
-			MapSprite(SPRITE_WHOOSH, whoosh_map);
-			sprites[SPRITE_BULLET1+b].tileIndex = 0;
-			break;
-		default:
-			break;
+			if( y < LEVEL_TILES_Y ) {
+				PLANE_SET( col_plane[y], v, c );
+			}
+		}
+		v = 0;
+		run = n;
 	}
-	bullet[b].status = status;
 }
 
-int new_bullet( void ) {
+// Goes with ClearVram(), for a playfield of blank tiles.
+void clear_plane( void ) {
+	unsigned char *p = &col_plane[0][0];
 	int i;
-	for( i=0 ; i < MAX_BULLETS ; i++ ) {
-		if( bullet[i].status == BULLET_FREE ) {
-			set_bullet( i, BULLET_CHARGING );
-			bullet[i].x = 0;
-			bullet[i].y = 0;
-			return i;
-		}
+
+	for( i=0 ; i<sizeof(col_plane) ; i++ ) {
+		*p++ = 0;
 	}
-	return -1; // No bullet slots left.
 }
 
-void update_bullet( int b ) {
-	if( bullet[b].status != BULLET_FREE ) {
-		if( bullet[b].x >= SCREEN_TILES_H*8 ) {
-			set_bullet(b, BULLET_FREE);
-			if( bullet[b].status == BULLET_LARGE ) {
-				for( int i=0 ; i<MAX_ENEMIES ; i++ ) {
-					enemies[i].whooshed = 0;
+#if COL_FINE
+unsigned int tile_fine( unsigned char v ) {
+	if( v >= RAM_TILES_COUNT ) {
+		return pgm_read_word( &bg_col_fine[tileset][v-RAM_TILES_COUNT] );
+	}
+	return v < pgm_read_byte( &anim_tiles[tileset] ) ? anim_fine[v] : 0;
+}
+
+// Lay two tiles' fine masks side by side, a row of cells to a byte.
+void fine_rows( unsigned int left, unsigned int right, unsigned char *rows ) {
+	rows[0] = ((left >> 8) & 0xf0) | (right >> 12);
+	rows[1] = ((left >> 4) & 0xf0) | ((right >> 8) & 0x0f);
+	rows[2] = (left & 0xf0)        | ((right >> 4) & 0x0f);
+	rows[3] = ((left << 4) & 0xf0) | (right & 0x0f);
+}
+#endif
+
+// Enemies sleep on a timer wheel until their next event is due, so only
+// those with something to do are visited each frame. Each slot lists the
+// enemies waking on frames which land on it; waits longer than the wheel
+// go round extra laps. Anything added to the slot being run is held back
+// in the extra WHEEL_LATER list until it's finished.
+#define WHEEL_SLOTS 32
+#define WHEEL_LATER WHEEL_SLOTS
+#define WHEEL_NONE  0xff
+unsigned char wheel[WHEEL_SLOTS+1];
+unsigned char wheel_pos;
+bool wheel_busy;
+
+void unschedule( int e ) {
+	unsigned char next = enemies.next[e];
+	unsigned char prev = enemies.prev[e];
+
+	if( enemies.wheel[e] == WHEEL_NONE ) {
+		return;
+	}
+	if( prev == WHEEL_NONE ) {
+		wheel[enemies.wheel[e]] = next;
+	}
+	else {
+		enemies.next[prev] = next;
+	}
+	if( next != WHEEL_NONE ) {
+		enemies.prev[next] = prev;
+	}
+	enemies.wheel[e] = WHEEL_NONE;
+}
+
+void wheel_link( int e, unsigned char slot ) {
+	enemies.wheel[e] = slot;
+	enemies.prev[e] = WHEEL_NONE;
+	enemies.next[e] = wheel[slot];
+	if( wheel[slot] != WHEEL_NONE ) {
+		enemies.prev[wheel[slot]] = e;
+	}
+	wheel[slot] = e;
+}
+
+// Wake the enemy up again in the given number of frames (at least 1).
+void schedule( int e, unsigned char wait ) {
+	unsigned char slot = (wheel_pos + wait) % WHEEL_SLOTS;
+
+	unschedule( e );
+	enemies.laps[e] = (wait-1) / WHEEL_SLOTS;
+	if( wheel_busy && slot == wheel_pos ) {
+		slot = WHEEL_LATER;
+	}
+	wheel_link( e, slot );
+}
+
+void clear_wheel() {
+	int i;
+
+	for( i=0 ; i<=WHEEL_SLOTS ; i++ ) {
+		wheel[i] = WHEEL_NONE;
+	}
+	for( i=0 ; i<MAX_ENEMIES ; i++ ) {
+		enemies.wheel[i] = WHEEL_NONE;
+	}
+}
+
+// Which enemy can be hit in each vram cell, as a nibble holding its pool
+// index plus one, two cells to a byte. Enemies mark their hitbox when they
+// appear or move and unmark it when they go, so the hit test needn't look
+// through them all. Level columns a whole ring apart share cells, so the
+// enemy found still has to be checked. A cell has only one owner, so any
+// others under a hitbox being unmarked take their cells back.
+unsigned char enemy_grid[(VRAM_TILES_V*VRAM_TILES_H)/2];
+
+// True if the hitboxes of two enemies overlap.
+bool enemies_overlap( int a, int b ) {
+	unsigned char ba = pgm_read_byte( &enemy_hitbox[(int)enemies.id[a]] );
+	unsigned char bb = pgm_read_byte( &enemy_hitbox[(int)enemies.id[b]] );
+
+	return enemies.x[a] < enemies.x[b] + (bb >> 4) && enemies.x[b] < enemies.x[a] + (ba >> 4)
+	    && enemies.y[a] < enemies.y[b] + (bb & 0x0f) && enemies.y[b] < enemies.y[a] + (ba & 0x0f);
+}
+
+void mark_enemy( int e, bool on ) {
+	unsigned char box = pgm_read_byte( &enemy_hitbox[(int)enemies.id[e]] );
+	unsigned char mark = on ? e+1 : 0;
+	unsigned char *g;
+	int xx, yy, y, c, v, n, o;
+
+	if( box == 0 ) {
+		return;
+	}
+	v = VRAM_X(enemies.x[e]);
+	for( yy=0 ; yy<(box & 0x0f) ; yy++ ) {
+		y = enemies.y[e] + yy;
+		if( y < 0 || y >= VRAM_TILES_V ) {
+			continue;
+		}
+		for( xx=0 ; xx<(box >> 4) ; xx++ ) {
+			c = (y*VRAM_TILES_H) + ((v+xx) & (VRAM_TILES_H-1));
+			g = &enemy_grid[c >> 1];
+			// Only unmark cells which are still ours.
+			if( c & 1 ) {
+				if( on || (*g >> 4) == e+1 ) {
+					*g = (*g & 0x0f) | (mark << 4);
+				}
+			}
+			else {
+				if( on || (*g & 0x0f) == e+1 ) {
+					*g = (*g & 0xf0) | mark;
 				}
 			}
 		}
-		else {
-			switch( bullet[b].status ) {
-				case BULLET_CHARGING:
-					bullet[b].x = ship.x + 21;
-					bullet[b].y = ship.y + 9;
-					if( bullet_charge > BULLET_CHARGE_MAX/8 ) {
-						if( frame % 4 == 0 ) {
-							sprites[SPRITE_BULLET1+b].tileIndex++;
-							if( sprites[SPRITE_BULLET1+b].tileIndex > 5 ) {
-								sprites[SPRITE_BULLET1+b].tileIndex = 3;
-							}
-						}
-					}
-					MoveSprite(SPRITE_BULLET1+b, bullet[b].x,bullet[b].y, 1,1);
-					break;
-				case BULLET_SMALL:
-				case BULLET_MEDIUM:
-					bullet[b].x += BULLET_SPEED;
-					MoveSprite(SPRITE_BULLET1+b, bullet[b].x,bullet[b].y, 1,1);
-					break;
-				case BULLET_LARGE:
-					if( bullet[b].x >= (SCREEN_TILES_H*8)-16 ) {
-						// Prevent wrapping
-						sprites[SPRITE_WHOOSH+2].tileIndex = 0;
-						sprites[SPRITE_WHOOSH+3].tileIndex = 0;
-						sprites[SPRITE_WHOOSH+6].tileIndex = 0;
-						sprites[SPRITE_WHOOSH+7].tileIndex = 0;
-					}
-					bullet[b].x += BULLET_SPEED;
-					MoveSprite(SPRITE_WHOOSH, bullet[b].x,bullet[b].y, 4,2);
-					break;
-				default:
-					break;
+	}
+
+	if( !on ) {
+		for( n=0 ; n<enemy_count ; n++ ) {
+			o = enemy_active[n];
+			if( o != e && enemies_overlap( o, e ) ) {
+				mark_enemy( o, true );
 			}
 		}
 	}
 }
 
+void move_enemy( int e, char dx, char dy ) {
+	mark_enemy( e, false );
+	enemies.x[e] += dx;
+	enemies.y[e] += dy;
+	mark_enemy( e, true );
+}
+
+void set_script( int e, enemy_id_t id ) {
+	// The new type may have a different hitbox.
+	mark_enemy( e, false );
+	enemies.id[e] = id;
+	mark_enemy( e, true );
+
+	// Start from the top on the next update.
+	enemies.pc[e] = 0;
+	schedule( e, 1 );
+}
+
 void fill_tiles( int x, int y, int width, int height, unsigned char t ) {
-	int xx,yy,p;
+	int yy,v;
+
+	// Only what's in view, the rest isn't in vram.
+	if( x < camera_column ) {
+		width -= camera_column - x;
+		x = camera_column;
+	}
+	if( x + width > camera_column + VRAM_TILES_H ) {
+		width = camera_column + VRAM_TILES_H - x;
+	}
+	if( width <= 0 ) {
+		return;
+	}
 
+	v = VRAM_X(x);
+	vram_gen++;
 	for( yy=0 ; yy<height ; yy++ ) {
-		p = ((y+yy)*VRAM_TILES_H) + x;
-		for( xx=0 ; xx<width ; xx++ ) {
-			vram[p] = t+RAM_TILES_COUNT;
-			p++;
-			if( p % VRAM_TILES_H == 0 ) {
-				p -= VRAM_TILES_H;
-			}
-		}
+		put_row( v, y+yy, width, NULL, t+RAM_TILES_COUNT );
 	}
+}
 
+void erase_enemy( int e ) {
+	enemy_handler_t erase = (enemy_handler_t)pgm_read_word( &enemy_erase[(int)enemies.id[e]] );
+	unsigned char foot;
+
+	if( erase ) {
+		erase( e );
+	}
+	else {
+		foot = pgm_read_byte( &enemy_footprint[(int)enemies.id[e]] );
+		fill_tiles( enemies.x[e], enemies.y[e], foot >> 4, foot & 0x0f, 0 );
+	}
 }
 
-void clear_enemy( int e ) {
-	switch( enemies[e].id ) {
-		// 1x1
-		case ENEMY_MORTAR:
-			SetTile( enemies[e].x, enemies[e].y, 0 );
-			break;
-		// 2x2
-		case ENEMY_MINE:
-		case ENEMY_MORTAR_LAUNCHER:
-		case ENEMY_EXP_2X2:
-			fill_tiles( enemies[e].x, enemies[e].y, 2, 2, 0 );
-			break;
-		// 3x2
-		case ENEMY_HORNET:
-		case ENEMY_EXP_3X2:
-			fill_tiles( enemies[e].x, enemies[e].y, 3, 2, 0 );
-			break;
-		// 3x3
-		case POWER_UP_SPEED:
-		case POWER_UP_CHARGE:
-		case POWER_UP_MISSILE:
-		case POWER_UP_BOMB:
-			fill_tiles( enemies[e].x, enemies[e].y, 3, 3, 0 );
-			break;
-		// 4x2
-		case ENEMY_SPINNER:
-			fill_tiles( enemies[e].x, enemies[e].y, 4, 2, 0 );		
-			break;
-		default:
-			break;
+// Find the least important live enemy below the given priority and erase
+// it, leaving its place in the active list to be reused.
+int evict_enemy( unsigned char priority ) {
+	int n, i, victim = -1;
+	unsigned char p;
+
+	for( n=0 ; n<enemy_count ; n++ ) {
+		i = enemy_active[n];
+		p = pgm_read_byte( &enemy_priority[(int)enemies.id[i]] );
+		if( p < priority ) {
+			priority = p;
+			victim = i;
+		}
+	}
+	if( victim >= 0 ) {
+		erase_enemy( victim );
+		mark_enemy( victim, false );
 	}
-	enemies[e].x = level_vram_column;
-	enemies[e].y = 0;
-	enemies[e].id = ENEMY_NONE;
+	return victim;
 }
 
-void clear_enemies() {
+int add_enemy( enemy_id_t id, int x, int y ) {
 	int i;
-	
-	for( i=0 ; i<MAX_ENEMIES ; i++ ) {
-		clear_enemy(i);
+
+	if( id == ENEMY_WORM ) {
+		// Its body is kept in one buffer, see update_worm().
+		for( i=0 ; i<enemy_count ; i++ ) {
+			if( enemies.id[enemy_active[i]] == ENEMY_WORM ) {
+				return -1;
+			}
+		}
+	}
+
+	if( enemy_free_count ) {
+		i = enemy_free[--enemy_free_count];
+		enemies.slot[i] = enemy_count;
+		enemy_active[enemy_count++] = i;
+	}
+	else {
+		i = evict_enemy( pgm_read_byte( &enemy_priority[id] ) );
+		if( i < 0 ) {
+			return -1;
+		}
+	}
+
+	enemies.id[i] = id;
+	enemies.x[i] = x;
+	enemies.y[i] = y;
+	enemies.hp[i] = pgm_read_byte( &enemy_hp[id] );
+	enemies.whooshed[i] = 0;
+	enemies.flags[i] = 0;
+	enemies.count[i] = 0;
+	set_script( i, id );
+	if( id == ENEMY_EYEBALL ) {
+		boss_enemies++;
 	}
+	return i;
 }
 
-void draw_enemy( char x, char y, const char *map ) {
-	unsigned char width = pgm_read_byte(map);
-	unsigned char height = pgm_read_byte(map+1);
-	char *t = (char*)map+2;
-	int xx,yy,p;
+// Returns the object, or -1 if they're all in use.
+int mux_add( unsigned char tile, unsigned char prio, unsigned char x, unsigned char y ) {
+	int o;
+
+	for( o=0 ; o<MAX_MUX ; o++ ) {
+		if( mux[o].tile == 0 ) {
+			mux[o].x = x;
+			mux[o].y = y;
+			mux[o].tile = tile;
+			mux[o].tile2 = 0;
+			mux[o].prio = prio;
+			return o;
+		}
+	}
+	return -1;
+}
 
-	for( yy=0 ; yy<height ; yy++ ) {
-		p = ((y+yy)*VRAM_TILES_H) + x;
-		for( xx=0 ; xx<width ; xx++ ) {
-			if( pgm_read_byte(t) != 0 ) {
-				vram[p] = pgm_read_byte(t)+RAM_TILES_COUNT;
+void mux_free( int o ) {
+	mux[o].tile = 0;
+}
+
+// Show an object as a one or two sprite wide map, as for MapSprite().
+void mux_map( int o, const char *map ) {
+	mux[o].tile = pgm_read_byte( &map[2] );
+	mux[o].tile2 = pgm_read_byte( &map[0] ) > 1 ? pgm_read_byte( &map[3] ) : 0;
+}
+
+int add_alien( int x, int y ) {
+	int a;
+
+	for( a=0 ; a<MAX_ALIENS ; a++ ) {
+		if( alien[a].status == ALIEN_FREE ) {
+			alien[a].x = ((x - camera_column) * 8) - (Screen.scrollX % 8);
+			alien[a].y = y*8;
+			if( alien[a].y < 12 ) {
+				alien[a].y = 12;
 			}
-			t++;
-			p++;
-			if( p % VRAM_TILES_H == 0 ) {
-				p -= VRAM_TILES_H;
+			else if( alien[a].y > (LEVEL_TILES_Y*8)-ALIEN_H-12 ) {
+				alien[a].y = (LEVEL_TILES_Y*8)-ALIEN_H-12;
 			}
+			alien[a].hp = pgm_read_byte( &enemy_hp[ENEMY_ALIEN] );
+			alien[a].step = 0;
+			alien[a].sprite = mux_add( pgm_read_byte( &alien_map[2] ), PRIO_NORMAL, alien[a].x, alien[a].y );
+			if( alien[a].sprite < 0 ) {
+				return -1; // Nothing left to show it with.
+			}
+			mux_map( alien[a].sprite, alien_map );
+			alien[a].status = ALIEN_FLYING;
+			return a;
 		}
 	}
+	return -1; // No alien slots left.
 }
 
-void update_enemies() {
-	int i;
+void clear_aliens( void ) {
+	int a;
 
-	for( i=0 ; i<MAX_ENEMIES ; i++ ) {
-		if( enemies[i].x < 0 ) {
-			enemies[i].x = VRAM_TILES_H - 1;
-		}
-		if( enemies[i].x >= VRAM_TILES_H ) {
-			enemies[i].x = 0;
-		}
-		if( enemies[i].x == level_vram_column-3
-		||  enemies[i].y < 0 
-		||  enemies[i].y >= VRAM_TILES_V ) {
-			clear_enemy( i );
-		}
-		else {
-			switch( enemies[i].id ) {
-				case ENEMY_NONE:
-					break;
-				case ENEMY_MINE:
-					switch( enemies[i].anim_step % 60 ) {
-						case 0:
-							draw_enemy( enemies[i].x, enemies[i].y, mine_map[0] );
-							break;
-						case 30:
-							draw_enemy( enemies[i].x, enemies[i].y, mine_map[1] );
-							break;
-						default:
-							break;
-					}
-					break;
-				case ENEMY_MORTAR_LAUNCHER:
-					if( enemies[i].anim_step % 90 == 0 ) {
-						draw_enemy( enemies[i].x, enemies[i].y, mortar_map );
-						add_enemy( ENEMY_MORTAR, enemies[i].x-1, enemies[i].y-1 );
-					}
-					break;
-				case ENEMY_MORTAR:
-					switch( enemies[i].anim_step % 8 ) {
-						case 0:
-							SetTile( enemies[i].x, enemies[i].y, MORTAR_BR );
-							break;
-						case 4:
-							SetTile( enemies[i].x, enemies[i].y, MORTAR_TL );
-							break;
-						case 7:
-							SetTile( enemies[i].x, enemies[i].y, 0 );
-							enemies[i].x--;
-							enemies[i].y--;
-							break;
-					}
-					break;
-				case ENEMY_SPINNER:
-					switch( enemies[i].anim_step % 16 ) {
-						case 0:
-							fill_tiles( enemies[i].x, enemies[i].y, 4, 2, 0 );
-							draw_enemy( enemies[i].x, enemies[i].y, spinner_map[0] );
-							break;
-						case 4:
-							draw_enemy( enemies[i].x, enemies[i].y, spinner_map[1] );
-							break;
-						case 8:
-							draw_enemy( enemies[i].x, enemies[i].y, spinner_map[2] );
-							break;
-						case 12:
-							draw_enemy( enemies[i].x, enemies[i].y, spinner_map[3] );
-							break;
-						case 15:
-							enemies[i].x--;
-							break;
-						default:
-							break;
-					}
-					break;
-				case ENEMY_EYEBALL:
-					switch( enemies[i].anim_step ) {
-						case 0:
-							// Closed, set timer.
-							draw_enemy( enemies[i].x, enemies[i].y, eyeball_map[0] );
-							enemies[i].anim_step = (random()%120) - (i%4)*20;
-							break;
-						case 420:
-							// Open eye.
-							draw_enemy( enemies[i].x, enemies[i].y, eyeball_map[1] );
-							break;
-						case 540:
-						case 550:
-						case 560:
-						case 570:
-						case 580:
-						case 590:
-						case 600:
-						case 610:
-						case 620:
-						case 630:
-						case 640:
-						case 650:
-							// Fire!
-							fill_tiles( enemies[i].x-VRAM_TILES_H+5, enemies[i].y+1, VRAM_TILES_H-5, 1, 52 );
-							fill_tiles( enemies[i].x-VRAM_TILES_H+5, enemies[i].y+2, VRAM_TILES_H-5, 1, 53 );
-							if( Screen.scrollY == 0 ) Scroll( 0, -2 );
-							break;
-						case 545:
-						case 555:
-						case 565:
-						case 575:
-						case 585:
-						case 595:
-						case 605:
-						case 615:
-						case 625:
-						case 635:
-						case 645:
-						case 655:
-							// Beam flash
-							fill_tiles( enemies[i].x-VRAM_TILES_H+5, enemies[i].y+1, VRAM_TILES_H-5, 1, 53 );
-							fill_tiles( enemies[i].x-VRAM_TILES_H+5, enemies[i].y+2, VRAM_TILES_H-5, 1, 52 );
-							SetScrolling( Screen.scrollX, 0 );
-							break;
-						case 660:
-							// Stop firing
-							fill_tiles( enemies[i].x-VRAM_TILES_H+5, enemies[i].y+1, VRAM_TILES_H-5, 2, 0 );
-							break;
-						case 780:
-							// Loop
-							enemies[i].anim_step = -1;
-							break;
-					}
-					break;
-				case ENEMY_TENTACLE:
-					switch( enemies[i].anim_step % 40 ) {
-						case 0:
-							draw_enemy( enemies[i].x, enemies[i].y, tentacle_map[0] );
-							enemies[i].anim_step = random()%12;
-							break;
-						case 20:
-							draw_enemy( enemies[i].x, enemies[i].y, tentacle_map[1] );
-							break;
-					}
-					break;
-				case ENEMY_HORNET:
-					switch( enemies[i].anim_step % 4 ) {
-						case 0:
-							fill_tiles( enemies[i].x, enemies[i].y, 3, 2, 0 );
-							draw_enemy( enemies[i].x, enemies[i].y, hornet_map[0] );
-							break;
-						case 2:
-							draw_enemy( enemies[i].x, enemies[i].y, hornet_map[1] );
-							break;
-					}
-					if( enemies[i].anim_step > 60 && enemies[i].anim_step % 4 == 0 ) {
-						enemies[i].x--;
-					}
-					break;
-				case POWER_UP_SPEED:
-				case POWER_UP_CHARGE:
-				case POWER_UP_MISSILE:
-				case POWER_UP_BOMB:
-					if( enemies[i].anim_step % 30 == 0 ) {
-						draw_enemy( enemies[i].x, enemies[i].y, power_up_map[tileset] );
-						if( enemies[i].x+1 == VRAM_TILES_H ) {
-							SetTile( 0, enemies[i].y+1, 58 + overlay_offset + enemies[i].id-POWER_UP_SPEED );
-						}
-						else {
-							SetTile( enemies[i].x+1, enemies[i].y+1, 58 + overlay_offset + enemies[i].id-POWER_UP_SPEED );
-						}
-					}
-					break;
+	for( a=0 ; a<MAX_ALIENS ; a++ ) {
+		alien[a].status = ALIEN_FREE;
+	}
+}
+
+void free_alien( int a ) {
+	mux_free( alien[a].sprite );
+	alien[a].status = ALIEN_FREE;
+}
 
-				case ENEMY_EXP_2X2:
-					switch( enemies[i].anim_step % 30 ) {
-						case 0:
-							draw_enemy( enemies[i].x, enemies[i].y, explosion_map_2x2[0] );
-							break;
-						case 10:
-							draw_enemy( enemies[i].x, enemies[i].y, explosion_map_2x2[1] );
-							break;
-						case 20:
-							fill_tiles( enemies[i].x, enemies[i].y, 2, 2, 0 );
-							clear_enemy(i);
-							break;
-						default:
-							break;
+void kill_alien( int a ) {
+	TriggerFx( SFX_EXP_S, 0xff, true );
+	score += pgm_read_word( &enemy_score[ENEMY_ALIEN] );
+	alien[a].status = ALIEN_EXPLODING;
+	alien[a].step = ALIEN_EXPLODE;
+}
+
+// Enemies from the level data go into the pool, unless drawn as sprites.
+void spawn_enemy( enemy_id_t id, int x, int y ) {
+	if( id == ENEMY_ALIEN ) {
+		add_alien( x, y );
+	}
+	else {
+		add_enemy( id, x, y );
+	}
+}
+
+// Lava is shown with an animated tile.
+#define LEVEL_TILE(t) ( tileset == 1 && (t) == LAVA_TILE ? ANIM_TILE(ANIM_LAVA) : (t) )
+
+void level_draw_column( void ) {
+	int y = 0;
+	int c = 0;
+	unsigned char *p = level_pos;
+	static int r = 22;
+
+	if( scroll_countdown )
+		return;
+
+	if( level_col_repeat ) {
+		// Copy previous column.
+		p = level_prev_column;
+	}
+	else {
+		if( pgm_read_byte(p) == 0xff ) {
+			// Magic...
+			p++;
+			if( pgm_read_byte(p) == 0xff ) {
+				// End of level
+				scroll_countdown = 24;
+				while( pgm_read_byte( &enemy_pos->id ) != ENEMY_NONE ) {
+					while( pgm_read_byte( &enemy_pos->x ) == level_column-3 ) {
+							spawn_enemy( pgm_read_byte( &enemy_pos->id ), level_column-3, pgm_read_byte( &enemy_pos->y ) );
+							enemy_pos++;
 					}
-					break;
-				case ENEMY_EXP_3X2:
-					switch( enemies[i].anim_step % 30 ) {
-						case 0:
-							draw_enemy( enemies[i].x, enemies[i].y, explosion_map_3x2[0] );
-							break;
-						case 5:
-							draw_enemy( enemies[i].x, enemies[i].y, explosion_map_3x2[1] );
-							break;
-						case 10:
-							draw_enemy( enemies[i].x, enemies[i].y, explosion_map_3x2[2] );
-							break;
-						case 15:
-							fill_tiles( enemies[i].x, enemies[i].y, 3, 2, 0 );
-							if( --next_power_up <= 0 ) {
-								enemies[i].id = POWER_UP_SPEED + random()%4;
-								enemies[i].anim_step = -1;
-								next_power_up = 10 + random()%10;
-							}
-							else {
-								clear_enemy(i);
-							}
-							break;
+					level_column++;
+					level_vram_column++;
+					if( level_vram_column >= VRAM_TILES_H ) {
+						level_vram_column = 0;
 					}
-					break;
-				default:
-					break;
+				}
+				return;
+			}
+			else {
+				// Repeat previous column
+				level_col_repeat = pgm_read_byte(p);
+				level_pos += 2;
+				p = level_prev_column;
 			}
-			enemies[i].anim_step++;
 		}
 	}
-}
 
-void text_write( char x, char y, const char *text, bool overlay ) {
-	char *p = (char*)text;
-	unsigned char t = 0;
-	
-	while( *p ) {
-		if ( *p >= 'A' && *p <= 'Z' ) {
-			t = *p - 'A' + 1;
-		}
-		else if( *p >= '0' && *p <= '9' ) {
-			t = *p - '0' + 32;
-		}
-		else {
-			switch( *p ) {
-				case '.': t=27; break;
-				case '!': t=28; break;
-				case '/': t=29; break;
-				case '?': t=30; break;
-				case '*': t=31; break;
-				case 'c': t=44; break;
-				default: t = 0; // blank
+	// Draw the actual column.
+	while( y<LEVEL_TILES_Y ) {
+		if( pgm_read_byte(p) == 0xff ) {
+			// Repeat previous tile
+			unsigned char t = pgm_read_byte(p-1);
+			p++;
+			for( c=pgm_read_byte(p) ; c>0 ; c-- ) {
+				if( t == 0 && r <= 0 ) {
+					// Random background filler
+					put_tile( level_vram_column, y, pgm_read_byte(&random_tiles[(int)level][random()%3]) + RAM_TILES_COUNT );
+					r = (random()%VRAM_TILES_H) + 1;
+				}
+				else {
+					put_tile( level_vram_column, y, LEVEL_TILE(t) + RAM_TILES_COUNT );
+					r--;
+				}
+				y++;
 			}
-		}
-		if( overlay ) {
-			vram[(VRAM_TILES_H*(VRAM_TILES_V+y))+x] = t + overlay_offset + RAM_TILES_COUNT;
-			x++;
+			p++;
 		}
 		else {
-			SetTile(x++, y, t + overlay_offset + (overlay ? RAM_TILES_COUNT : 0 ) );
+			put_tile( level_vram_column, y, LEVEL_TILE(pgm_read_byte(p)) + RAM_TILES_COUNT );
+			p++;
+			y++;
+		}
+	}
+	vram_gen++;
+
+	// Any new enemies?
+	while( pgm_read_byte( &enemy_pos->x ) == level_column-3 ) {
+		spawn_enemy( pgm_read_byte( &enemy_pos->id ), level_column-3, pgm_read_byte( &enemy_pos->y ) );
+		enemy_pos++;
+	}
+
+	if( level_col_repeat ) {
+		level_col_repeat--;
+	}
+	else {
+		level_prev_column = level_pos;
+		level_pos = p;
+	}
+
+	level_column++;	
+	level_vram_column++;
+	if( level_vram_column >= VRAM_TILES_H ) {
+		level_vram_column = 0;
+	}
+}
+
+void scroll( void ) {
+	static char wait = 0;
+
+	if( scroll_speed ) {
+		wait--;
+		if( wait <= 0 ) {
+			Scroll(1,0);
+			if( Screen.scrollX % 8 == 0 ) {
+				camera_column++;
+				level_draw_column();
+			}
+			wait = scroll_speed;
+			if( scroll_countdown ) {
+				scroll_countdown--;
+				if( scroll_countdown == 0 ) {
+					scroll_speed = 0;
+				}
+			}
+		}
+	}
+}
+
+// One row of collision cells from a sprite's or a tile's mask.
+#if COL_FINE
+#define CELL_ROW(mask,r)  (((mask) >> (12 - 4*(r))) & 0x0f)
+#define SPRITE_CELLS(t)   pgm_read_word( &sprite_col_fine[t] )
+#else
+#define CELL_ROW(mask,r)  (((mask) >> (2 - 2*(r))) & 0x03)
+#define SPRITE_CELLS(t)   pgm_read_byte( &sprite_col_map[t] )
+#endif
+
+void meta_move( metasprite_t *m, unsigned char x, unsigned char y ) {
+	const char *l = m->layout;
+	unsigned char i;
+
+	m->x = x;
+	m->y = y;
+	for( i=0 ; i<m->parts ; i++ ) {
+		sprites[m->first+i].x = x + pgm_read_byte(l++);
+		sprites[m->first+i].y = y + pgm_read_byte(l++);
+	}
+}
+
+// Rebuild the collision mask from the parts' tiles.
+void meta_build( metasprite_t *m ) {
+	const char *l = m->layout;
+	unsigned char i, r, cx, cy;
+	unsigned int cells;
+
+	for( r=0 ; r<META_MAX_H*COL_CELLS ; r++ ) {
+		m->rows[r] = 0;
+	}
+	m->flags = META_STALE;
+	for( i=0 ; i<m->parts ; i++ ) {
+		cx = pgm_read_byte(l++) / COL_STEP;
+		cy = pgm_read_byte(l++) / COL_STEP;
+		cells = SPRITE_CELLS( sprites[m->first+i].tileIndex );
+		if( cells ) {
+			for( r=0 ; r<COL_CELLS ; r++ ) {
+				m->rows[cy+r] |= CELL_ROW( cells, r ) << (META_BITS - COL_CELLS - cx);
+			}
+			m->flags |= META_SOLID;
+		}
+	}
+}
+
+// Like MapSprite(), placing the parts by layout around the origin.
+void meta_map( metasprite_t *m, const char *map, const char *layout ) {
+	unsigned char i;
+
+	m->parts = pgm_read_byte(map) * pgm_read_byte(map+1);
+	m->layout = layout;
+	for( i=0 ; i<m->parts ; i++ ) {
+		sprites[m->first+i].tileIndex = pgm_read_byte(map+2+i);
+	}
+	meta_build( m );
+	meta_move( m, m->x, m->y );
+}
+
+void meta_hide( metasprite_t *m ) {
+	unsigned char i;
+
+	for( i=0 ; i<m->parts ; i++ ) {
+		sprites[m->first+i].tileIndex = 0;
+	}
+	meta_build( m );
+}
+
+void clear_sprites( void ) {
+	int i;
+	for( i=0 ; i < MAX_SPRITES ; i++ ) {
+		sprites[i].tileIndex = 0;
+	}
+	meta_build( &ship_meta );
+	meta_build( &whoosh_meta );
+	for( i=0 ; i<MAX_MUX ; i++ ) {
+		mux[i].tile = 0;
+	}
+}
+
+// Give out the shared sprites for the next frame. Higher priorities go
+// in lower slots, so if the kernel runs short of ram tiles it's the less
+// important ones which aren't drawn. Each priority starts from the first
+// object left out last time, so those over the limit take turns. A two
+// sprite object is only shown whole.
+void mux_update( void ) {
+	unsigned char slot = SPRITE_MUX1;
+	unsigned char o, n, p;
+	int missed = -1;
+
+	for( p=PRIO_HIGH+1 ; p-- > 0 ; ) {
+		o = mux_turn;
+		for( n=0 ; n<MAX_MUX ; n++ ) {
+			if( mux[o].tile && mux[o].prio == p ) {
+				if( slot + (mux[o].tile2 ? 2 : 1) <= MAX_SPRITES ) {
+					sprites[slot].x = mux[o].x;
+					sprites[slot].y = mux[o].y;
+					sprites[slot].tileIndex = mux[o].tile;
+					slot++;
+					if( mux[o].tile2 ) {
+						sprites[slot].x = mux[o].x + 8;
+						sprites[slot].y = mux[o].y;
+						sprites[slot].tileIndex = mux[o].tile2;
+						slot++;
+					}
+				}
+				else if( missed < 0 ) {
+					missed = o;
+				}
+			}
+			o = (o+1) % MAX_MUX;
+		}
+	}
+	while( slot < MAX_SPRITES ) {
+		sprites[slot++].tileIndex = 0;
+	}
+	if( missed >= 0 ) {
+		mux_turn = missed;
+	}
+}
+
+void set_bullet( int b, bullet_status_t status ) {
+	switch( status ) {
+		case BULLET_FREE:
+			sprites[SPRITE_BULLET1+b].tileIndex = 0;
+			if( bullet[b].status == BULLET_LARGE ) {
+				meta_hide( &whoosh_meta );
+			}
+			break;
+		case BULLET_CHARGING:
+			sprites[SPRITE_BULLET1+b].tileIndex = 3;
+			break;
+		case BULLET_SMALL:
+			TriggerFx( SFX_FIRE, 0xff, true );
+			sprites[SPRITE_BULLET1+b].tileIndex = 2;
+			bullet[b].y++; // offset for small bullet sprite
+			bullet[b].y &= 0xfffe;
+			break;
+		case BULLET_MEDIUM:
+			TriggerFx( SFX_FIRE, 0xff, true );
+			sprites[SPRITE_BULLET1+b].tileIndex = 6;
+			bullet[b].y &= 0xfffe;
+			break;
+		case BULLET_LARGE:
+			TriggerFx( SFX_WHOOSH, 0xff, true );
+			bullet[b].y -= 4;
+			meta_map( &whoosh_meta, whoosh_map, whoosh_layout );
+			sprites[SPRITE_BULLET1+b].tileIndex = 0;
+			break;
+		default:
+			break;
+	}
+	bullet[b].status = status;
+}
+
+int new_bullet( void ) {
+	int i;
+	for( i=0 ; i < MAX_BULLETS ; i++ ) {
+		if( bullet[i].status == BULLET_FREE ) {
+			set_bullet( i, BULLET_CHARGING );
+			bullet[i].x = 0;
+			bullet[i].y = 0;
+			return i;
+		}
+	}
+	return -1; // No bullet slots left.
+}
+
+void update_bullet( int b ) {
+	if( bullet[b].status != BULLET_FREE ) {
+		if( bullet[b].x >= SCREEN_TILES_H*8 ) {
+			set_bullet(b, BULLET_FREE);
+			if( bullet[b].status == BULLET_LARGE ) {
+				for( int n=0 ; n<enemy_count ; n++ ) {
+					enemies.whooshed[enemy_active[n]] = 0;
+				}
+			}
+		}
+		else {
+			switch( bullet[b].status ) {
+				case BULLET_CHARGING:
+					bullet[b].x = ship.x + 21;
+					bullet[b].y = ship.y + 9;
+					if( bullet_charge > BULLET_CHARGE_MAX/8 ) {
+						if( frame % 4 == 0 ) {
+							sprites[SPRITE_BULLET1+b].tileIndex++;
+							if( sprites[SPRITE_BULLET1+b].tileIndex > 5 ) {
+								sprites[SPRITE_BULLET1+b].tileIndex = 3;
+							}
+						}
+					}
+					MoveSprite(SPRITE_BULLET1+b, bullet[b].x,bullet[b].y, 1,1);
+					break;
+				case BULLET_SMALL:
+				case BULLET_MEDIUM:
+					bullet[b].x += BULLET_SPEED;
+					MoveSprite(SPRITE_BULLET1+b, bullet[b].x,bullet[b].y, 1,1);
+					break;
+				case BULLET_LARGE:
+					if( bullet[b].x >= (SCREEN_TILES_H*8)-16 ) {
+						// Prevent wrapping
+						sprites[SPRITE_WHOOSH+2].tileIndex = 0;
+						sprites[SPRITE_WHOOSH+3].tileIndex = 0;
+						sprites[SPRITE_WHOOSH+6].tileIndex = 0;
+						sprites[SPRITE_WHOOSH+7].tileIndex = 0;
+						meta_build( &whoosh_meta );
+					}
+					bullet[b].x += BULLET_SPEED;
+					meta_move( &whoosh_meta, bullet[b].x, bullet[b].y );
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
+void clear_enemy( int e ) {
+	unsigned char last;
+
+	if( enemies.id[e] == ENEMY_NONE ) {
+		return;
+	}
+	erase_enemy( e );
+	unschedule( e );
+	mark_enemy( e, false );
+	enemies.id[e] = ENEMY_NONE;
+
+	// Fill the gap in the active list with the last entry.
+	last = enemy_active[--enemy_count];
+	enemy_active[enemies.slot[e]] = last;
+	enemies.slot[last] = enemies.slot[e];
+	enemy_free[enemy_free_count++] = e;
+}
+
+void clear_enemies() {
+	int i;
+	
+	for( i=0 ; i<enemy_count ; i++ ) {
+		erase_enemy( enemy_active[i] );
+	}
+	enemy_count = 0;
+	for( i=0 ; i<MAX_ENEMIES ; i++ ) {
+		enemies.id[i] = ENEMY_NONE;
+		enemy_free[i] = i;
+	}
+	enemy_free_count = MAX_ENEMIES;
+	clear_wheel();
+	for( i=0 ; i<sizeof(enemy_grid) ; i++ ) {
+		enemy_grid[i] = 0;
+	}
+}
+
+void draw_enemy( int x, char y, const char *map ) {
+	unsigned char width = pgm_read_byte(map);
+	unsigned char height = pgm_read_byte(map+1);
+	unsigned char skip = 0;
+	unsigned char end = width;
+	int yy,v;
+
+	if( x + width <= camera_column || x >= camera_column + VRAM_TILES_H ) {
+		return;
+	}
+
+	// Only the columns in view.
+	if( x < camera_column ) {
+		skip = camera_column - x;
+	}
+	if( x + width > camera_column + VRAM_TILES_H ) {
+		end = camera_column + VRAM_TILES_H - x;
+	}
+
+	v = VRAM_X(x+skip);
+	vram_gen++;
+	map += 2 + skip;
+	for( yy=0 ; yy<height ; yy++ ) {
+		put_row( v, y+yy, end-skip, map, 0 );
+		map += width;
+	}
+}
+
+void draw_delta( int x, char y, const unsigned char *delta ) {
+	unsigned char n = pgm_read_byte(delta);
+	unsigned char offset;
+	int v = VRAM_X(x);
+
+	// Each entry is a (y<<4)|x cell offset, followed by the tile.
+	vram_gen++;
+	while( n-- ) {
+		delta++;
+		offset = pgm_read_byte(delta);
+		delta++;
+		if( IN_VIEW(x + (offset & 0x0f)) ) {
+			put_row( (v + (offset & 0x0f)) & (VRAM_TILES_H-1), y + (offset >> 4), 1, NULL, pgm_read_byte(delta) + RAM_TILES_COUNT );
+		}
+	}
+}
+
+// Gone once it's far enough off the left, or off the top or bottom.
+bool enemy_offscreen( int i ) {
+	return enemies.x[i] < camera_column - CAMERA_MARGIN
+		|| enemies.y[i] < 0
+		|| enemies.y[i] >= VRAM_TILES_V;
+}
+
+void run_script( int i ) {
+	const unsigned char *script = (const unsigned char*)pgm_read_word( &enemy_script[(int)enemies.id[i]] );
+	unsigned char op, arg;
+
+	while( true ) {
+		op = pgm_read_byte( &script[enemies.pc[i]] );
+		arg = pgm_read_byte( &script[enemies.pc[i]+1] );
+		enemies.pc[i] += 2;
+
+		switch( op ) {
+			case A_FRAME:
+				draw_enemy( enemies.x[i], enemies.y[i], (const char*)pgm_read_word( &anim_frames[arg][tileset] ) );
+				break;
+			case A_DELTA:
+				draw_delta( enemies.x[i], enemies.y[i], (const unsigned char*)pgm_read_word( &anim_deltas[arg][tileset] ) );
+				break;
+#if SHIFT_COUNT
+			case A_SHIFT:
+				draw_delta( enemies.x[i], enemies.y[i], (const unsigned char*)pgm_read_word( &anim_shifts[arg][tileset] ) );
+				break;
+#endif
+			case A_TILE:
+				fill_tiles( enemies.x[i], enemies.y[i], 1, 1, arg );
+				break;
+			case A_CLEAR:
+				fill_tiles( enemies.x[i], enemies.y[i], arg >> 4, arg & 0x0f, 0 );
+				break;
+			case A_ICON:
+				fill_tiles( enemies.x[i]+1, enemies.y[i]+1, 1, 1, 58 + overlay_offset + enemies.id[i]-POWER_UP_SPEED );
+				break;
+			case A_BEAM:
+				switch( arg ) {
+					case BEAM_FIRE:
+						fill_tiles( enemies.x[i]-VRAM_TILES_H+5, enemies.y[i]+1, VRAM_TILES_H-5, 1, ANIM_TILE(ANIM_BEAM_TOP) );
+						fill_tiles( enemies.x[i]-VRAM_TILES_H+5, enemies.y[i]+2, VRAM_TILES_H-5, 1, ANIM_TILE(ANIM_BEAM_BOTTOM) );
+						SetScrolling( Screen.scrollX, 0 );
+						// Fall through
+					case BEAM_FLASH:
+						// The screen shakes in time with the beam.
+						if( Screen.scrollY == 0 ) {
+							set_anim_tile( ANIM_BEAM_TOP, 52 );
+							set_anim_tile( ANIM_BEAM_BOTTOM, 53 );
+							Scroll( 0, -2 );
+						}
+						else {
+							set_anim_tile( ANIM_BEAM_TOP, 53 );
+							set_anim_tile( ANIM_BEAM_BOTTOM, 52 );
+							SetScrolling( Screen.scrollX, 0 );
+						}
+						break;
+					default:
+						fill_tiles( enemies.x[i]-VRAM_TILES_H+5, enemies.y[i]+1, VRAM_TILES_H-5, 2, 0 );
+						break;
+				}
+				break;
+			case A_MOVE:
+				move_enemy( i, (char)arg >> 4, (char)(arg << 4) >> 4 );
+				if( enemy_offscreen( i ) ) {
+					clear_enemy( i );
+					return;
+				}
+				break;
+			case A_SPAWN:
+				add_enemy( arg, enemies.x[i], enemies.y[i] );
+				break;
+			case A_FLAGS:
+				// Keep EF_DOOMED, which belongs to the bomb, not the script.
+				enemies.flags[i] = (enemies.flags[i] & EF_DOOMED) | arg;
+				break;
+			case A_SHOOT:
+				fire_shot( i );
+				break;
+			case A_WAIT:
+				schedule( i, arg );
+				return;
+			case A_RANDOM:
+				schedule( i, 1 + random()%arg );
+				return;
+			case A_COUNT:
+				enemies.count[i] = arg;
+				break;
+			case A_LOOP:
+				if( --enemies.count[i] ) {
+					enemies.pc[i] = arg*2;
+				}
+				break;
+			case A_GOTO:
+				enemies.pc[i] = arg*2;
+				break;
+			case A_DROP:
+				if( --next_power_up <= 0 ) {
+					set_script( i, POWER_UP_SPEED + random()%4 );
+					next_power_up = 10 + random()%10;
+					return;
+				}
+				// Fall through...
+			case A_DIE:
+			default:
+				clear_enemy( i );
+				return;
+		}
+	}
+}
+
+// The worm's body follows the path taken by its head, which is kept in a
+// ring buffer. Each step draws the new head, turns the old one into body
+// and erases the tail, so the cost doesn't depend on the worm's length.
+// There's only one buffer, so add_enemy() won't let out a second worm.
+// Erased segments are just blanked, so the path has to stay clear of the
+// ground: WORM_RISE lifts it above the tallest terrain near where it's
+// placed in level 2, and it never comes back down below there.
+#define WORM_LENGTH 8
+#define WORM_SPEED  8
+#define WORM_RISE   4
+int worm_x[WORM_LENGTH];
+char worm_y[WORM_LENGTH];
+unsigned char worm_head;
+
+// Moves of the head, in whole 3x2 segments: up, over and back down.
+const unsigned char worm_path[] PROGMEM = {
+	MOVE(0,-2), MOVE(0,-2), MOVE(0,-2), MOVE(0,-2), MOVE(0,-2),
+	MOVE(-3,0),
+	MOVE(0,2),  MOVE(0,2),  MOVE(0,2),  MOVE(0,2),  MOVE(0,2),
+	MOVE(-3,0)
+};
+
+void update_worm( int i ) {
+	unsigned char move, tail;
+
+	schedule( i, WORM_SPEED );
+
+	if( enemies.count[i] == 0 ) {
+		// Appear just above the ground where it was placed.
+		move_enemy( i, 0, -WORM_RISE );
+		enemies.count[i] = 1;
+		worm_head = 0;
+		worm_x[0] = enemies.x[i];
+		worm_y[0] = enemies.y[i];
+		draw_enemy( worm_x[0], worm_y[0], worm_head_map );
+		return;
+	}
+
+	if( enemy_offscreen( i ) ) {
+		clear_enemy( i );
+		return;
+	}
+
+	move = pgm_read_byte( &worm_path[enemies.pc[i]] );
+	if( ++enemies.pc[i] == sizeof(worm_path) ) {
+		enemies.pc[i] = 0;
+	}
+
+	draw_enemy( worm_x[worm_head], worm_y[worm_head], worm_body_map );
+	worm_head = (worm_head + 1) % WORM_LENGTH;
+	if( enemies.count[i] == WORM_LENGTH ) {
+		// Fully out, so the tail is about to be overwritten by the head.
+		tail = worm_head;
+		fill_tiles( worm_x[tail], worm_y[tail], 3, 2, 0 );
+	}
+	else {
+		enemies.count[i]++;
+	}
+
+	move_enemy( i, (char)move >> 4, (char)(move << 4) >> 4 );
+	worm_x[worm_head] = enemies.x[i];
+	worm_y[worm_head] = enemies.y[i];
+	draw_enemy( enemies.x[i], enemies.y[i], worm_head_map );
+}
+
+void worm_erase( int e ) {
+	unsigned char s = worm_head;
+	unsigned char n;
+
+	for( n=0 ; n<enemies.count[e] ; n++ ) {
+		fill_tiles( worm_x[s], worm_y[s], 3, 2, 0 );
+		s = s ? s-1 : WORM_LENGTH-1;
+	}
+}
+
+void update_enemies() {
+	static int despawn_column = -1;
+	int i, n;
+	enemy_handler_t update;
+
+	// Enemies only go off screen when they move, which they check for
+	// themselves, or when the screen has scrolled on another column.
+	if( camera_column != despawn_column ) {
+		despawn_column = camera_column;
+		for( n=enemy_count ; n-- ; ) {
+			i = enemy_active[n];
+			if( enemy_offscreen( i ) ) {
+				clear_enemy( i );
+			}
+		}
+	}
+
+	wheel_pos = (wheel_pos + 1) % WHEEL_SLOTS;
+	wheel_busy = true;
+	while( wheel[wheel_pos] != WHEEL_NONE ) {
+		i = wheel[wheel_pos];
+		unschedule( i );
+		if( enemies.laps[i] ) {
+			enemies.laps[i]--;
+			wheel_link( i, WHEEL_LATER );
+		}
+		else {
+			// Handlers reschedule themselves, or sleep for good.
+			update = (enemy_handler_t)pgm_read_word( &enemy_update[(int)enemies.id[i]] );
+			if( update ) {
+				update( i );
+			}
+		}
+	}
+	wheel_busy = false;
+
+	// Anything held back goes round again.
+	while( wheel[WHEEL_LATER] != WHEEL_NONE ) {
+		i = wheel[WHEEL_LATER];
+		unschedule( i );
+		wheel_link( i, wheel_pos );
+	}
+}
+
+void text_write( char x, char y, const char *text, bool overlay ) {
+	char *p = (char*)text;
+	unsigned char t = 0;
+	
+	while( *p ) {
+		if ( *p >= 'A' && *p <= 'Z' ) {
+			t = *p - 'A' + 1;
+		}
+		else if( *p >= '0' && *p <= '9' ) {
+			t = *p - '0' + 32;
+		}
+		else {
+			switch( *p ) {
+				case '.': t=27; break;
+				case '!': t=28; break;
+				case '/': t=29; break;
+				case '?': t=30; break;
+				case '*': t=31; break;
+				case 'c': t=44; break;
+				default: t = 0; // blank
+			}
+		}
+		if( overlay ) {
+			hud_put( x++, y, t + overlay_offset + RAM_TILES_COUNT );
+		}
+		else {
+			SetTile(x++, y, t + overlay_offset + (overlay ? RAM_TILES_COUNT : 0 ) );
+		}
+		p++;
+	}
+}
+
+char text_code( int offset ) {
+	if( offset >= 1 && offset <= 26 ) {
+		return 'A' + offset-1;
+	}
+	else if ( offset >= 32 && offset <= 41 ) {
+		return '0' + offset-32;
+	}
+	else {
+		switch( offset ) {
+			case 27: return '.';
+			case 28: return '!';
+			case 29: return '/';
+			case 30: return '?';
+			case 31: return '*';
+			default: return ' ';
+		}
+	}
+}
+
+void text_write_number( char x, char y, unsigned long num, align_t align, bool overlay ) {
+	char digits[15];
+	int pos = 0;
+	
+	digits[pos] = 0;
+
+	while(num > 0) {
+		digits[pos] = num%10;
+		num -= digits[pos];
+		num /= 10;
+		pos++;
+	}
+
+	if( align == ALIGN_RIGHT ) {
+		x-=(pos-1);
+	}
+
+	if(pos == 0) {
+		if( align == ALIGN_RIGHT )
+			x--;
+		pos++;
+	}
+	while(--pos >= 0) {
+		if( overlay ) {
+			hud_put( x++, y, digits[pos] + 32 + overlay_offset + RAM_TILES_COUNT );
+		}
+		else {
+			SetTile(x++,y,digits[pos] + 32 + overlay_offset );
+		}
+	}
+}
+
+void update_score( void ) {
+	if( score > MAX_SCORE ) score = MAX_SCORE;
+	text_write_number( 1, 1, score, ALIGN_LEFT, true );
+}
+
+void update_charge( void ) {
+	int i;
+	char offset = 0;
+
+	for( i=0 ; i<10 ; i++ ) {
+		if( bullet_charge > (BULLET_CHARGE_MAX/10)*i )
+			offset = 52;
+		else
+			offset = 49;
+		
+		if( i == 0 )
+			offset--;
+		else if( i == 9 )
+			offset++;		
+		
+		hud_put( i+9, 1, overlay_offset + RAM_TILES_COUNT + offset );
+	}
+}
+
+void update_lives() {
+	if( lives > MAX_LIVES ) lives = MAX_LIVES;
+	hud_put( 26, 1, lives + 32 + overlay_offset + RAM_TILES_COUNT );
+}
+
+void init_overlay() {
+	int i;
+
+	Screen.overlayHeight=OVERLAY_LINES;
+
+	// Clear overlay
+	for( i=0 ; i<VRAM_TILES_H ; i++ ) {
+		hud_put( i, 0, RAM_TILES_COUNT );
+		hud_put( i, 1, RAM_TILES_COUNT );
+	}
+
+	// "Score" text
+	text_write( 1, 0, "SCORE", true );
+
+	// "Charge" text
+	text_write( (SCREEN_TILES_H-6)/2, 0, "CHARGE", true );
+	
+	// Lives counter
+	hud_put( 24, 1, overlay_offset + RAM_TILES_COUNT + 62 );
+	hud_put( 25, 1, overlay_offset + RAM_TILES_COUNT + 63 );
+
+	update_score();
+	update_charge();
+	update_lives();
+}
+
+// Vram is exactly 256 pixels wide, so a sprite's position on it wraps
+// round by itself.
+#if VRAM_TILES_H*TILE_WIDTH != 256
+#error col_check() relies on vram being 256 pixels wide.
+#endif
+unsigned char col_scroll_x;		// Screen.scrollX, taken once a frame
+
+// Which of the 2x2 tiles under a sprite, at px across vram, it overlaps.
+unsigned int col_test( int sprite, unsigned char px ) {
+	unsigned char smap = pgm_read_byte( &sprite_col_map[sprites[sprite].tileIndex] );
+
+	if( smap==0 ) {
+		// If all empty, no chance of collision.
+		return 0;
+	}
+	else {
+		int x = px / 8;
+		int offset_x = px % 8;
+		int y = sprites[sprite].y / 8;
+		int offset_y = sprites[sprite].y % 8;
+
+		// Build up a bitmap representing a 2x2 grid extending from the
+		// tile the top-left corner of the sprite occupies, going round the
+		// vram ring.
+		// +-----+-----+
+		// |15 14|11 10|
+		// |13 12| 9  8|
+		// +-----+-----+
+		// | 7  6| 3  2|
+		// | 5  4| 1  0|
+		// +-----+-----+
+		unsigned char *plane = col_plane[y];
+		unsigned char x2 = (x+1) & (VRAM_TILES_H-1);
+		unsigned int t = (PLANE_COL( plane, x ) << 12) | (PLANE_COL( plane, x2 ) << 8);
+		unsigned int hit = 0;
+
+		// Fill bottom row?
+		if( y < LEVEL_TILES_Y-1 ) {
+			plane += VRAM_TILES_H/2;
+			t |= (PLANE_COL( plane, x ) << 4) | PLANE_COL( plane, x2 );
+		}
+
+		// No chance of collision if all tiles are empty.
+		if( t == 0 ) {
+			return 0;
+		}
+
+#if COL_FINE
+		// The 2x2 grid of tiles in 2x2 pixel cells, a row of both
+		// columns to a byte.
+		// Only tiles with something solid are looked up, as they will be
+		// once vram_queue is written, to match the plane.
+		unsigned char bg[8];
+		unsigned char n[4];
+		unsigned char r, g, sr, lr;
+		unsigned int s;
+
+		fine_rows(
+			(t & 0xf000) ? tile_fine( queued_tile( x, y ) ) : 0,
+			(t & 0x0f00) ? tile_fine( queued_tile( x2, y ) ) : 0,
+			bg );
+		fine_rows(
+			(t & 0x00f0) ? tile_fine( queued_tile( x, y+1 ) ) : 0,
+			(t & 0x000f) ? tile_fine( queued_tile( x2, y+1 ) ) : 0,
+			bg+4 );
+
+		// Move each row of the sprite's cells across and down by its
+		// offset into the grid, and AND it with the tiles.
+		s = pgm_read_word( &sprite_col_fine[sprites[sprite].tileIndex] );
+		n[0] = s >> 12;
+		n[1] = (s >> 8) & 0x0f;
+		n[2] = (s >> 4) & 0x0f;
+		n[3] = s & 0x0f;
+		// An odd offset leaves each sprite cell across two of the grid's,
+		// so it's tested against both rather than rounded off.
+		for( r=0 ; r<4 ; r++ ) {
+			sr = pgm_read_byte( &col_row_shift[n[r]][offset_x/2] );
+			if( offset_x & 1 ) {
+				sr |= pgm_read_byte( &col_row_shift[n[r]][offset_x/2+1] );
+			}
+			for( g=r+(offset_y/2) ; g<=r+((offset_y+1)/2) ; g++ ) {
+				lr = sr & bg[g];
+				if( lr ) {
+					// Report the tiles hit as whole ones in the coarse format.
+					if( g < 4 ) {
+						hit |= ((lr & 0xf0) ? 0xf000 : 0) | ((lr & 0x0f) ? 0x0f00 : 0);
+					}
+					else {
+						hit |= ((lr & 0xf0) ? 0x00f0 : 0) | ((lr & 0x0f) ? 0x000f : 0);
+					}
+				}
+			}
+		}
+#else
+		// Do the same for the sprite, taking the offset into the 2x2
+		// tile grid into account, and AND the bitmasks.
+		hit = t & pgm_read_word( &sprite_col_shift[smap][COL_OFFSET(offset_y)][COL_OFFSET(offset_x)] );
+#endif
+
+		// A collision will produce > 0.
+		return hit;
+	}
+}
+
+unsigned int col_check( int sprite, int *tile_x, int *tile_y ) {
+	unsigned char px = col_scroll_x + sprites[sprite].x;
+	col_cache_t *c = &col_cache[sprite-SPRITE_BULLET1];
+
+	if( c->x != px || c->y != sprites[sprite].y
+	 || c->tile != sprites[sprite].tileIndex || c->gen != vram_gen ) {
+		c->x = px;
+		c->y = sprites[sprite].y;
+		c->tile = sprites[sprite].tileIndex;
+		c->gen = vram_gen;
+		c->map = col_test( sprite, px );
+	}
+
+	*tile_x = px / 8;
+	*tile_y = sprites[sprite].y / 8;
+	return c->map;
+}
+
+// As col_check(), for a sprite which has moved dist pixels right since it
+// was last tested, so also tests the positions it passed through.
+unsigned int col_sweep( int sprite, unsigned char dist, int *tile_x, int *tile_y ) {
+	unsigned char px = col_scroll_x + sprites[sprite].x - dist;
+	unsigned int hit;
+
+	while( dist > COL_STEP ) {
+		px += COL_STEP;
+		dist -= COL_STEP;
+		hit = col_test( sprite, px );
+		if( hit ) {
+			*tile_x = px / 8;
+			*tile_y = sprites[sprite].y / 8;
+			return hit;
+		}
+	}
+	return col_check( sprite, tile_x, tile_y );
+}
+
+// Which tiles under a metasprite, at px across vram, it overlaps, as a
+// bit for each in a (META_MAX_W+1) x (META_MAX_H+1) grid, top-left first.
+unsigned int meta_test( metasprite_t *m, unsigned char px ) {
+	unsigned char x = px / 8;
+	unsigned char y = m->y / 8;
+	unsigned char c = (px % 8) / COL_STEP;
+	unsigned char oy = (m->y % 8) / COL_STEP;
+	unsigned int mask[(META_MAX_H+1)*(META_MAX_W+1)];
+	unsigned int hits = 0;
+	unsigned long row;
+	unsigned char r, tx, ty, cy, i, v, k;
+	unsigned char spread = 0;
+	bool solid = false;
+
+	// Only tiles with something solid are looked up.
+	for( ty=0, i=0 ; ty<=META_MAX_H ; ty++ ) {
+		for( tx=0 ; tx<=META_MAX_W ; tx++, i++ ) {
+			mask[i] = 0;
+			if( y+ty < LEVEL_TILES_Y ) {
+				v = (x+tx) & (VRAM_TILES_H-1);
+				mask[i] = PLANE_COL( col_plane[y+ty], v );
+#if COL_FINE
+				if( mask[i] ) {
+					mask[i] = tile_fine( queued_tile( v, y+ty ) );
+				}
+#endif
+				solid |= (mask[i] != 0);
+			}
+		}
+	}
+	if( !solid ) {
+		return 0;
+	}
+
+#if !COL_FINE
+	// As in col_test(), a quadrant part way into the next covers both.
+	spread = (m->y % COL_STEP) ? 1 : 0;
+#endif
+
+	// Move each row of the mask across and down by the offset into the
+	// top-left tile, and AND it with each tile's row of cells.
+	for( r=0 ; r<META_MAX_H*COL_CELLS ; r++ ) {
+		if( m->rows[r] ) {
+			row = ((unsigned long)m->rows[r] << COL_CELLS) >> c;
+#if !COL_FINE
+			if( px % COL_STEP ) {
+				row |= row >> 1;
+			}
+#endif
+			for( k=0 ; k<=spread ; k++ ) {
+				ty = (r+oy+k) / COL_CELLS;
+				cy = (r+oy+k) % COL_CELLS;
+				i = ty * (META_MAX_W+1);
+				for( tx=0 ; tx<=META_MAX_W ; tx++, i++ ) {
+					if( CELL_ROW( mask[i], cy ) & (row >> ((META_MAX_W-tx)*COL_CELLS)) ) {
+						hits |= 1 << i;
+					}
+				}
+			}
+		}
+	}
+	return hits;
+}
+
+unsigned int meta_check( metasprite_t *m, int *tile_x, int *tile_y ) {
+	unsigned char px = col_scroll_x + m->x;
+
+	*tile_x = px / 8;
+	*tile_y = m->y / 8;
+	if( !(m->flags & META_SOLID) ) {
+		return 0;
+	}
+	if( m->col_x != px || m->col_y != m->y || m->col_gen != vram_gen
+	 || (m->flags & META_STALE) ) {
+		m->col_x = px;
+		m->col_y = m->y;
+		m->col_gen = vram_gen;
+		m->flags &= ~META_STALE;
+		m->hits = meta_test( m, px );
+	}
+	return m->hits;
+}
+
+void eyeball_killed( int e ) {
+	fill_tiles( enemies.x[e]-VRAM_TILES_H+5, enemies.y[e]+1, VRAM_TILES_H-5, 2, 0 );
+	fill_tiles( enemies.x[e], enemies.y[e]-1, 1, 4, 0 );
+	draw_enemy( enemies.x[e]+1, enemies.y[e]-1, dead_eyeball_map );
+	boss_enemies--;
+}
+
+void kill_enemy( int i ) {
+	unsigned char id = enemies.id[i];
+	enemy_handler_t killed;
+
+	TriggerFx( SFX_EXP_S, 0xff, true );
+	spawn_debris( i );
+	score += pgm_read_word( &enemy_score[id] );
+	enemies.flags[i] &= ~EF_DOOMED;
+	killed = (enemy_handler_t)pgm_read_word( &enemy_killed[id] );
+	if( killed ) {
+		killed( i );
+	}
+	id = pgm_read_byte( &enemy_dies_as[id] );
+	if( id == ENEMY_NONE ) {
+		clear_enemy( i );
+	}
+	else {
+		erase_enemy( i );
+		set_script( i, id );
+	}
+}
+
+void collect_speed( int e ) {
+	ship.speed++;
+	if( ship.speed > SHIP_MAX_SPEED ) {
+		ship.speed = SHIP_MAX_SPEED;
+	}
+}
+
+// The bomb damages everything on screen straight away, but only marks
+// those it destroys. update_bomb() then blows them up a few at a time, so
+// a screen full of enemies doesn't make for one very long frame.
+#define BOMB_DAMAGE          8
+#define BOMB_KILLS_PER_FRAME 2
+bool bomb_pending;
+
+void collect_bomb( int e ) {
+	int i, n;
+
+	TriggerFx( SFX_EXP_L, 0xff, true );
+	for( n=0 ; n<enemy_count ; n++ ) {
+		i = enemy_active[n];
+		if( enemies.hp[i] == HP_INFINITE
+		||  pgm_read_byte( &enemy_hitbox[(int)enemies.id[i]] ) == 0
+		||  (enemies.flags[i] & (EF_SHIELDED|EF_DOOMED)) ) {
+			continue;
+		}
+		enemies.hp[i] -= BOMB_DAMAGE;
+		if( enemies.hp[i] <= 0 ) {
+			enemies.flags[i] |= EF_DOOMED;
+			bomb_pending = true;
+		}
+	}
+	for( i=0 ; i<MAX_ALIENS ; i++ ) {
+		if( alien[i].status == ALIEN_FLYING ) {
+			kill_alien( i );
+		}
+	}
+}
+
+void update_bomb() {
+	int i, n;
+	int kills = 0;
+
+	if( !bomb_pending ) {
+		return;
+	}
+	// Backwards, as kill_enemy() may remove the enemy from the list.
+	for( n=enemy_count ; n-- && kills < BOMB_KILLS_PER_FRAME ; ) {
+		i = enemy_active[n];
+		if( enemies.flags[i] & EF_DOOMED ) {
+			kill_enemy( i );
+			kills++;
+		}
+	}
+	if( kills < BOMB_KILLS_PER_FRAME ) {
+		bomb_pending = false;
+	}
+}
+
+bool enemy_covers( int i, int x, int y ) {
+	unsigned char box = pgm_read_byte( &enemy_hitbox[(int)enemies.id[i]] );
+
+	return x >= enemies.x[i] && x < enemies.x[i] + (box >> 4)
+		&& y >= enemies.y[i] && y < enemies.y[i] + (box & 0x0f);
+}
+
+#define ENEMY_HITTABLE(i) (!(enemies.flags[i] & (EF_SHIELDED|EF_DOOMED)))
+
+// The enemy which can be hit at a level column and row, or -1.
+int enemy_at( int x, int y ) {
+	int c, i, n;
+
+	if( y < 0 || y >= VRAM_TILES_V ) {
+		return -1;
+	}
+	c = (y*VRAM_TILES_H) + VRAM_X(x);
+	i = (c & 1 ? enemy_grid[c >> 1] >> 4 : enemy_grid[c >> 1] & 0x0f) - 1;
+	if( i < 0 ) {
+		return -1;
+	}
+	if( enemy_covers( i, x, y ) && ENEMY_HITTABLE( i ) ) {
+		return i;
+	}
+
+	// The cell belongs to a column a ring away, or to an enemy which can't
+	// be hit just now and might have another underneath, so look properly.
+	for( n=0 ; n<enemy_count ; n++ ) {
+		i = enemy_active[n];
+		if( enemy_covers( i, x, y ) && ENEMY_HITTABLE( i ) ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool check_enemy_hit( int x, int y, bullet_status_t b ) {
+	int i = enemy_at( x, y );
+	unsigned char id;
+	enemy_handler_t collect;
+
+	if( i < 0 ) {
+		return false;
+	}
+	id = enemies.id[i];
+
+	if( b == BULLET_FREE && IS_POWER_UP(id) ) {
+		// Collison with ship
+		collect = (enemy_handler_t)pgm_read_word( &enemy_killed[id] );
+		collect( i );
+		clear_enemy(i);
+		return false;
+	}
+
+	if( enemies.hp[i] != HP_INFINITE ) {
+		switch( b ) {
+			case BULLET_SMALL:
+				enemies.hp[i]--;
+				break;
+			case BULLET_MEDIUM:
+				enemies.hp[i] -= 4;
+				break;
+			case BULLET_LARGE:
+				if( ! enemies.whooshed[i] ) {
+					enemies.hp[i] -= 8;
+					enemies.whooshed[i] = 1;
+				}
+				break;
+			default:
+				break;
+		}
+		if( enemies.hp[i] <= 0 ) {
+			kill_enemy( i );
+		}
+		return true;
+	}
+	return false;
+}
+
+bool check_colmap_hit( unsigned int col_map, int col_x, int col_y, bullet_status_t b ) {
+	bool hit = false;
+
+	col_x = LEVEL_X( col_x );
+	if( col_map & 0xf000 ) {
+		hit |= check_enemy_hit( col_x, col_y, b );
+	}
+	if( col_map & 0x0f00 ) {
+		hit |= check_enemy_hit( col_x+1, col_y, b );
+	}
+	if( col_map & 0x00f0 ) {
+		hit |= check_enemy_hit( col_x, col_y+1, b );
+	}
+	if( col_map & 0x000f ) {
+		hit |= check_enemy_hit( col_x+1, col_y+1, b );
+	}
+	return hit;
+}
+
+// The same, for the tiles hit by a metasprite.
+bool check_meta_hit( unsigned int hits, int col_x, int col_y, bullet_status_t b ) {
+	bool hit = false;
+	unsigned char tx, ty;
+
+	col_x = LEVEL_X( col_x );
+	for( ty=0 ; ty<=META_MAX_H && hits ; ty++ ) {
+		for( tx=0 ; tx<=META_MAX_W ; tx++ ) {
+			if( hits & 1 ) {
+				hit |= check_enemy_hit( col_x+tx, col_y+ty, b );
+			}
+			hits >>= 1;
 		}
-		p++;
 	}
+	return hit;
 }
 
-char text_code( int offset ) {
-	if( offset >= 1 && offset <= 26 ) {
-		return 'A' + offset-1;
+void collect_missile( int e ) {
+	ship.missiles += MISSILE_AMMO;
+	if( ship.missiles > MISSILE_MAX ) {
+		ship.missiles = MISSILE_MAX;
 	}
-	else if ( offset >= 32 && offset <= 41 ) {
-		return '0' + offset-32;
+}
+
+void clear_missiles( void ) {
+	int m;
+
+	for( m=0 ; m<MAX_MISSILES ; m++ ) {
+		missile[m].sprite = -1;
 	}
-	else {
-		switch( offset ) {
-			case 27: return '.';
-			case 28: return '!';
-			case 29: return '/';
-			case 30: return '?';
-			case 31: return '*';
-			default: return ' ';
+}
+
+void launch_missile( void ) {
+	int m, o;
+
+	for( m=0 ; m<MAX_MISSILES ; m++ ) {
+		if( missile[m].sprite < 0 ) {
+			o = mux_add( MISSILE_TILE, PRIO_NORMAL, ship.x+16, ship.y+8 );
+			if( o < 0 ) {
+				return;
+			}
+			missile[m].x = FIX( ship.x+16 );
+			missile[m].y = FIX( ship.y+8 );
+			missile[m].dx = MISSILE_SPEED;
+			missile[m].dy = 0;
+			missile[m].target = -1;
+			missile[m].sprite = o;
+			missile_turn = m;
+			ship.missiles--;
+			return;
 		}
 	}
 }
 
-void text_write_number( char x, char y, unsigned long num, align_t align, bool overlay ) {
-	char digits[15];
-	int pos = 0;
-	
-	digits[pos] = 0;
+void free_missile( int m ) {
+	mux_free( missile[m].sprite );
+	missile[m].sprite = -1;
+}
 
-	while(num > 0) {
-		digits[pos] = num%10;
-		num -= digits[pos];
-		num /= 10;
-		pos++;
-	}
+// Middle of an enemy's hitbox on screen, or of the missile sprite.
+int enemy_screen_x( int i ) {
+	unsigned char box = pgm_read_byte( &enemy_hitbox[(int)enemies.id[i]] );
+	return ((enemies.x[i] - camera_column) * 8) - (Screen.scrollX % 8) + (box >> 4) * 4 - 4;
+}
 
-	if( align == ALIGN_RIGHT ) {
-		x-=(pos-1);
-	}
+int enemy_screen_y( int i ) {
+	unsigned char box = pgm_read_byte( &enemy_hitbox[(int)enemies.id[i]] );
+	return (enemies.y[i] * 8) + (box & 0x0f) * 4 - 4;
+}
 
-	if(pos == 0) {
-		if( align == ALIGN_RIGHT )
-			x--;
-		pos++;
-	}
-	while(--pos >= 0) {
-		if( overlay ) {
-			vram[(VRAM_TILES_H*(VRAM_TILES_V+y))+x] = digits[pos] + 32 + overlay_offset + RAM_TILES_COUNT;
-			x++;
+// True if a missile can go after the enemy, once it's in view.
+bool missile_can_hit( int i ) {
+	return enemies.id[i] != ENEMY_NONE
+	    && enemies.hp[i] != HP_INFINITE
+	    && pgm_read_byte( &enemy_hitbox[(int)enemies.id[i]] ) != 0
+	    && !(enemies.flags[i] & (EF_SHIELDED|EF_DOOMED));
+}
+
+// The nearest enemy in view which can be hurt, or -1.
+int missile_target( int m ) {
+	int x = UNFIX( missile[m].x );
+	int y = UNFIX( missile[m].y );
+	int i, n, best = -1;
+	unsigned int d, best_d = 0xffff;
+
+	for( n=0 ; n<enemy_count ; n++ ) {
+		i = enemy_active[n];
+		if( !missile_can_hit( i ) || !IN_VIEW( enemies.x[i] ) ) {
+			continue;
 		}
-		else {
-			SetTile(x++,y,digits[pos] + 32 + overlay_offset );
+		d = abs( enemy_screen_x( i ) - x ) + abs( enemy_screen_y( i ) - y );
+		if( d < best_d ) {
+			best_d = d;
+			best = i;
 		}
 	}
+	return best;
 }
 
-void update_score( void ) {
-	if( score > MAX_SCORE ) score = MAX_SCORE;
-	text_write_number( 1, 1, score, ALIGN_LEFT, true );
+// Steer towards a target, a fixed point position, along one axis.
+char missile_steer( char d, int from, int to ) {
+	if( to > from ) {
+		d += MISSILE_TURN;
+	}
+	else {
+		d -= MISSILE_TURN;
+	}
+	if( d > MISSILE_SPEED ) {
+		d = MISSILE_SPEED;
+	}
+	else if( d < -MISSILE_SPEED ) {
+		d = -MISSILE_SPEED;
+	}
+	return d;
 }
 
-void update_charge( void ) {
-	int i;
-	char offset = 0;
+void update_missiles( void ) {
+	int m, t, x, y, cx, cy;
+	unsigned char q;
 
-	for( i=0 ; i<10 ; i++ ) {
-		if( bullet_charge > (BULLET_CHARGE_MAX/10)*i )
-			offset = 52;
-		else
-			offset = 49;
-		
-		if( i == 0 )
-			offset--;
-		else if( i == 9 )
-			offset++;		
-		
-		vram[(VRAM_TILES_H*VRAM_TILES_V)+VRAM_TILES_H+i+9] = overlay_offset + RAM_TILES_COUNT + offset;
+	missile_turn = (missile_turn+1) % MAX_MISSILES;
+	for( m=0 ; m<MAX_MISSILES ; m++ ) {
+		if( missile[m].sprite < 0 ) {
+			continue;
+		}
+
+		if( m == missile_turn ) {
+			missile[m].target = missile_target( m );
+		}
+		t = missile[m].target;
+		if( t >= 0 && !missile_can_hit( t ) ) {
+			// Gone, or its slot's now an explosion or some such, so carry
+			// straight on until the next look.
+			missile[m].target = t = -1;
+		}
+		if( t >= 0 ) {
+			missile[m].dx = missile_steer( missile[m].dx, missile[m].x, FIX( enemy_screen_x( t ) ) );
+			missile[m].dy = missile_steer( missile[m].dy, missile[m].y, FIX( enemy_screen_y( t ) ) );
+		}
+		missile[m].x += missile[m].dx;
+		missile[m].y += missile[m].dy;
+
+		x = UNFIX( missile[m].x );
+		y = UNFIX( missile[m].y );
+		if( x < -8 || x >= SCREEN_TILES_H*8 || y < 0 || y >= LEVEL_TILES_Y*8 ) {
+			free_missile( m );
+			continue;
+		}
+
+		// Hit whatever's under the middle of it, enemy or otherwise. The
+		// plane has a bit for each quarter of a tile, as in tiles1.col.
+		cx = x + 4 + Screen.scrollX % 8;
+		cy = y + 4;
+		if( cx >= 0 && cy < LEVEL_TILES_Y*8 ) {
+			q = (cx % 8) < 4 ? 0x0a : 0x05;
+			q &= (cy % 8) < 4 ? 0x0c : 0x03;
+			if( check_enemy_hit( camera_column + cx / 8, cy / 8, MISSILE_DAMAGE )
+			||  (PLANE_COL( col_plane[cy / 8], VRAM_X( camera_column + cx / 8 ) ) & q) ) {
+				free_missile( m );
+				continue;
+			}
+		}
+		mux[(int)missile[m].sprite].x = x;
+		mux[(int)missile[m].sprite].y = y;
 	}
 }
 
-void update_lives() {
-	if( lives > MAX_LIVES ) lives = MAX_LIVES;
-	vram[(VRAM_TILES_H*(VRAM_TILES_V+1))+26] = lives + 32 + overlay_offset + RAM_TILES_COUNT;
+void crash_ship( void ) {
+	if( ship.status != STATUS_EXPLODING ) {
+		ship.status = STATUS_EXPLODING;
+		ship.anim_step = 16;
+	}
 }
 
-void init_overlay() {
-	int i;
+// True if two boxes, in screen pixels, overlap.
+#define OVERLAP(x1,y1,w1,h1, x2,y2,w2,h2) \
+	( (x1) < (x2)+(w2) && (x2) < (x1)+(w1) && (y1) < (y2)+(h2) && (y2) < (y1)+(h1) )
 
-	Screen.overlayHeight=OVERLAY_LINES;
+void clear_shots( void ) {
+	int s;
 
-	// Clear overlay
-	for( i=0 ; i<VRAM_TILES_H ; i++ ) {
-		vram[(VRAM_TILES_H*VRAM_TILES_V)+i] = RAM_TILES_COUNT;
-		vram[(VRAM_TILES_H*(VRAM_TILES_V+1))+i] = RAM_TILES_COUNT;
+	for( s=0 ; s<MAX_SHOTS ; s++ ) {
+		shot[s].live = false;
+		sprites[SPRITE_SHOT1+s].tileIndex = 0;
 	}
+}
 
-	// "Score" text
-	text_write( 1, 0, "SCORE", true );
+// Fires from the middle of an enemy at the middle of the ship.
+void fire_shot( int e ) {
+	int s, x, y, dx, dy;
 
-	// "Charge" text
-	text_write( (SCREEN_TILES_H-6)/2, 0, "CHARGE", true );
-	
-	// Lives counter
-	vram[(VRAM_TILES_H*(VRAM_TILES_V+1))+24] = overlay_offset + RAM_TILES_COUNT + 62;
-	vram[(VRAM_TILES_H*(VRAM_TILES_V+1))+25] = overlay_offset + RAM_TILES_COUNT + 63;
+	if( ship.status != STATUS_OK || !IN_VIEW( enemies.x[e] ) ) {
+		return;
+	}
+	for( s=0 ; s<shot_limit && shot[s].live ; s++ );
+	if( s == shot_limit ) {
+		return;
+	}
 
-	update_score();
-	update_charge();
-	update_lives();
+	x = enemy_screen_x( e );
+	y = enemy_screen_y( e );
+	if( x < 0 || x >= SCREEN_TILES_H*8 ) {
+		return;
+	}
+
+	dx = abs( ship.x + 8 - x );
+	dy = abs( ship.y + 8 - y );
+	while( dx >= SHOT_AIM_STEPS || dy >= SHOT_AIM_STEPS ) {
+		dx >>= 1;
+		dy >>= 1;
+	}
+	shot[s].dx = pgm_read_byte( &shot_aim[dy][dx][0] );
+	shot[s].dy = pgm_read_byte( &shot_aim[dy][dx][1] );
+	if( ship.x + 8 < x ) {
+		shot[s].dx = -shot[s].dx;
+	}
+	if( ship.y + 8 < y ) {
+		shot[s].dy = -shot[s].dy;
+	}
+	shot[s].x = FIX( x );
+	shot[s].y = FIX( y );
+	shot[s].live = true;
+	sprites[SPRITE_SHOT1+s].x = x;
+	sprites[SPRITE_SHOT1+s].y = y;
+	sprites[SPRITE_SHOT1+s].tileIndex = SHOT_TILE;
 }
 
-unsigned int col_check( int sprite, int *tile_x, int *tile_y ) {
-	unsigned char smap = pgm_read_byte( &sprite_col_map[sprites[sprite].tileIndex] );
+void free_shot( int s ) {
+	shot[s].live = false;
+	sprites[SPRITE_SHOT1+s].tileIndex = 0;
+}
 
-	if( smap==0 ) {
-		// If all empty, no chance of collision.
-		return 0;
-	}
-	else {
-		int x = ((Screen.scrollX + sprites[sprite].x) / 8) % VRAM_TILES_H;
-		int offset_x = (Screen.scrollX + sprites[sprite].x) % 8;
-		int y = sprites[sprite].y / 8;
-		int offset_y = sprites[sprite].y % 8;
+void update_shots( void ) {
+	int s, x, y;
 
-		// This is the tile the top-left corner of the sprite occupies.
-		unsigned char *tile = &vram[(y*VRAM_TILES_H) + x];
-		
-		// Build up a bitmap representing a 2x2 grid extending from the tile.
-		// +-----+-----+
-		// |15 14|11 10|
-		// |13 12| 9  8|
-		// +-----+-----+
-		// | 7  6| 3  2|
-		// | 5  4| 1  0|
-		// +-----+-----+
-		unsigned int t = pgm_read_byte( &bg_col_map[tileset][(*tile)-RAM_TILES_COUNT]) << 12;
-		if( x == VRAM_TILES_H-1 ) {
-			t |= pgm_read_byte( &bg_col_map[tileset][(*(tile-VRAM_TILES_H-1))-RAM_TILES_COUNT] ) << 8;
+	for( s=0 ; s<MAX_SHOTS ; s++ ) {
+		if( !shot[s].live ) {
+			continue;
 		}
-		else {
-			t |= pgm_read_byte( &bg_col_map[tileset][(*(tile+1))-RAM_TILES_COUNT] ) << 8;
+		shot[s].x += shot[s].dx;
+		shot[s].y += shot[s].dy;
+
+		x = UNFIX( shot[s].x );
+		y = UNFIX( shot[s].y );
+		if( x < -8 || x >= SCREEN_TILES_H*8 || y < -8 || y >= LEVEL_TILES_Y*8 ) {
+			free_shot( s );
+			continue;
 		}
 
-		// Fill bottom row?
-		if( y < LEVEL_TILES_Y-1 ) {
-			t |= pgm_read_byte( &bg_col_map[tileset][(*(tile+VRAM_TILES_H))-RAM_TILES_COUNT] ) << 4;
-			if( x == VRAM_TILES_H-1 ) {
-				t |= pgm_read_byte( &bg_col_map[tileset][(*(tile+1))-RAM_TILES_COUNT] );
-			}
-			else {
-				t |= pgm_read_byte( &bg_col_map[tileset][(*(tile+VRAM_TILES_H+1))-RAM_TILES_COUNT] );
-			}
+		// The capsule is the middle 4x4 pixels of its sprite.
+		if( ship.status == STATUS_OK
+		&&  OVERLAP( ship.x, ship.y+8, 24, 8, x+2, y+2, 4, 4 ) ) {
+			crash_ship();
+			free_shot( s );
+			continue;
 		}
+		sprites[SPRITE_SHOT1+s].x = x;
+		sprites[SPRITE_SHOT1+s].y = y;
+	}
+}
 
-		// No chance of collision if all tiles are empty.
-		if( t == 0 ) {
-			return 0;
-		}
+void clear_debris( void ) {
+	int d;
 
-		// Do the same for the sprite, taking the offset into the 2x2
-		// tile grid into account.
-		unsigned int s = smap << 12;
-		if( offset_x != 0 ) {
-			// OR to the right
-			s |= ((s & 0xa000) >> 1)
-			  |  ((s & 0x5000) >> 3);
-			if( offset_x > 3 ) {
-				// Shift right
-				s = ((s & 0xa000) >> 1)
-				  | ((s & 0x5000) >> 3)
-				  | ((s & 0x0a00) >> 1);
-			}
-		}
+	for( d=0 ; d<MAX_DEBRIS ; d++ ) {
+		debris[d].sprite = -1;
+	}
+}
 
-		if( offset_y > 0 ) {
-			// OR downwards
-			s |= ((s & 0xcc00) >> 2)
-			  |  ((s & 0x3300) >> 6);
-			if( offset_y > 3 ) {
-				// Shift downwards
-				s = ((s & 0xcc00) >> 2)
-				  | ((s & 0x3300) >> 6)
-				  | ((s & 0x00cc) >> 2);
-			}
+void spawn_debris( int e ) {
+	int d, o, x, y, n = DEBRIS_PIECES;
+	unsigned char dir = random();
+
+	if( !IN_VIEW( enemies.x[e] )
+	||  ((vram_head - vram_tail) & (VRAM_QUEUE-1)) > DEBRIS_BUSY ) {
+		return;
+	}
+	x = enemy_screen_x( e );
+	y = enemy_screen_y( e );
+	if( x < 0 || x >= SCREEN_TILES_H*8 ) {
+		return;
+	}
+
+	for( d=0 ; d<MAX_DEBRIS && n && debris_budget ; d++ ) {
+		if( debris[d].sprite >= 0 ) {
+			continue;
+		}
+		o = mux_add( DEBRIS_TILE + (n & 3), PRIO_COSMETIC, x, y );
+		if( o < 0 ) {
+			return;
 		}
+		dir = (dir + 2 + (n & 1)) & 7;
+		debris[d].x = FIX( x );
+		debris[d].y = FIX( y );
+		debris[d].dx = pgm_read_byte( &debris_spray[dir][0] );
+		debris[d].dy = pgm_read_byte( &debris_spray[dir][1] );
+		debris[d].life = DEBRIS_LIFE - (n & 3);
+		debris[d].sprite = o;
+		debris_budget--;
+		n--;
+	}
+}
 
-		// Now just AND the bitmasks - a collision will produce > 0;
-		if( s & t ) {
-			*tile_x = x;
-			*tile_y = y;
-			return s & t;
+void free_debris( int d ) {
+	mux_free( debris[d].sprite );
+	debris[d].sprite = -1;
+}
+
+void update_debris( void ) {
+	int d, x, y;
+
+	debris_budget = DEBRIS_BUDGET;
+	for( d=0 ; d<MAX_DEBRIS ; d++ ) {
+		if( debris[d].sprite < 0 ) {
+			continue;
+		}
+		debris[d].x += debris[d].dx;
+		debris[d].y += debris[d].dy;
+		debris[d].dy += DEBRIS_GRAVITY;
+
+		x = UNFIX( debris[d].x );
+		y = UNFIX( debris[d].y );
+		if( --debris[d].life == 0
+		||  x < -8 || x >= SCREEN_TILES_H*8 || y < -8 || y >= LEVEL_TILES_Y*8 ) {
+			free_debris( d );
+			continue;
 		}
+		mux[(int)debris[d].sprite].x = x;
+		mux[(int)debris[d].sprite].y = y;
 	}
-	return 0;
 }
 
-bool check_enemy_hit( int x, int y, bullet_status_t b ) {
-	int i;
-	char hit = 0;
-	
-	for( i=0 ; i<MAX_ENEMIES ; i++ ) {
-		switch( enemies[i].id ) {
-			case ENEMY_NONE:
-				break;
-			case ENEMY_MINE:
-			case ENEMY_MORTAR_LAUNCHER:
-			case ENEMY_HORNET:
-				if((x == enemies[i].x || x == enemies[i].x+1)
-				&& (y == enemies[i].y || y == enemies[i].y+1) ) {
-					hit = 1;
+// Returns true if the bullet hit the alien.
+bool check_alien_hit( int a, int b, unsigned char x, unsigned char y ) {
+	switch( bullet[b].status ) {
+		case BULLET_SMALL:
+			if( OVERLAP( bullet[b].x, bullet[b].y, 8, 8, x, y, ALIEN_W, ALIEN_H ) ) {
+				alien[a].hp--;
+				set_bullet( b, BULLET_FREE );
+				return true;
+			}
+			break;
+		case BULLET_MEDIUM:
+			if( OVERLAP( bullet[b].x, bullet[b].y, 8, 8, x, y, ALIEN_W, ALIEN_H ) ) {
+				alien[a].hp -= 4;
+				set_bullet( b, BULLET_FREE );
+				return true;
+			}
+			break;
+		case BULLET_LARGE:
+			// More than any alien can take, so no need to remember it.
+			if( OVERLAP( bullet[b].x, bullet[b].y, 32, 16, x, y, ALIEN_W, ALIEN_H ) ) {
+				alien[a].hp -= 8;
+				return true;
+			}
+			break;
+		default:
+			break;
+	}
+	return false;
+}
+
+void update_aliens( void ) {
+	int a, b;
+	unsigned char x, y;
+
+	for( a=0 ; a<MAX_ALIENS ; a++ ) {
+		switch( alien[a].status ) {
+			case ALIEN_FLYING:
+				if( alien[a].x == 0 ) {
+					free_alien( a );
+					break;
 				}
-				break;
-			case ENEMY_SPINNER:
-				if((x >= enemies[i].x && x <= enemies[i].x+2)
-				&& (y == enemies[i].y || y == enemies[i].y+1) ) {
-					hit = 1;
+				alien[a].x--;
+				alien[a].step++;
+				x = alien[a].x;
+				y = alien[a].y + pgm_read_byte( &alien_wave[alien[a].step % ALIEN_WAVE_STEPS] );
+				mux[(int)alien[a].sprite].x = x;
+				mux[(int)alien[a].sprite].y = y;
+
+				if( ship.status == STATUS_OK
+				&&  OVERLAP( ship.x, ship.y+8, 24, 8, x, y, ALIEN_W, ALIEN_H ) ) {
+					crash_ship();
+					kill_alien( a );
+					break;
 				}
-				break;
-			case ENEMY_EYEBALL:
-				if((x == enemies[i].x || x == enemies[i].x+1)
-				&& (y == enemies[i].y || y == enemies[i].y+1)
-				&& (enemies[i].anim_step >= 420 && enemies[i].anim_step <= 780) ) {
-					hit = 1;
+				for( b=0 ; b<MAX_BULLETS ; b++ ) {
+					if( check_alien_hit( a, b, x, y ) && alien[a].hp <= 0 ) {
+						kill_alien( a );
+						break;
+					}
 				}
 				break;
-			case POWER_UP_SPEED:
-			case POWER_UP_CHARGE:
-			case POWER_UP_MISSILE:
-			case POWER_UP_BOMB:
-				if((x >= enemies[i].x && x <= enemies[i].x+2)
-				&& (y == enemies[i].y && y <= enemies[i].y+2) ) {
-					hit = 1;
+			case ALIEN_EXPLODING:
+				if( alien[a].step == 0 ) {
+					free_alien( a );
+				}
+				else {
+					mux_map( alien[a].sprite, alien_explosion_map[alien[a].step > ALIEN_EXPLODE/2 ? 0 : 1] );
+					mux[(int)alien[a].sprite].y = alien[a].y + pgm_read_byte( &alien_wave[alien[a].step % ALIEN_WAVE_STEPS] );
+					alien[a].step--;
 				}
 				break;
 			default:
 				break;
 		}
-		if( hit ) {
-			if( b == BULLET_FREE ) {
-				// Collison with ship
-				switch( enemies[i].id ) {
-					case POWER_UP_SPEED:
-					case POWER_UP_CHARGE:
-					case POWER_UP_MISSILE:
-					case POWER_UP_BOMB:
-						ship.speed++;
-						if( ship.speed > SHIP_MAX_SPEED ) {
-							ship.speed = SHIP_MAX_SPEED;
-						}
-						clear_enemy(i);
-						return false;
-						break;
-					default:
-						break;
-				}
-			}
-
-			if( enemies[i].hp != HP_INFINITE ) {
-				switch( b ) {
-					case BULLET_SMALL:
-						enemies[i].hp--;
-						break;
-					case BULLET_MEDIUM:
-						enemies[i].hp -= 4;
-						break;
-					case BULLET_LARGE:
-						if( ! enemies[i].whooshed ) {
-							enemies[i].hp -= 8;
-							enemies[i].whooshed = 1;
-						}
-						break;
-					default:
-						break;
-				}
-				if( enemies[i].hp <= 0 ) {
-					TriggerFx( SFX_EXP_S, 0xff, true );
-					score += pgm_read_word( &enemy_score[(int)enemies[i].id] );
-					switch( enemies[i].id ) {
-						case ENEMY_EYEBALL:
-							fill_tiles( enemies[i].x-VRAM_TILES_H+5, enemies[i].y+1, VRAM_TILES_H-5, 2, 0 );
-							fill_tiles( enemies[i].x, enemies[i].y-1, 1, 4, 0 );
-							draw_enemy( enemies[i].x+1, enemies[i].y-1, dead_eyeball_map );
-							boss_enemies--;
-							// Fall through...
-						case ENEMY_MINE:
-						case ENEMY_MORTAR_LAUNCHER:
-							enemies[i].id = ENEMY_EXP_2X2;
-							enemies[i].anim_step = 0;
-							break;
-						case ENEMY_SPINNER:
-						case ENEMY_HORNET:
-							fill_tiles( enemies[i].x, enemies[i].y, 4, 2, 0 );
-							enemies[i].id = ENEMY_EXP_3X2;
-							enemies[i].anim_step = 0;
-							break;
-						default:
-							break;
-					}
-				}
-				return true;
-			}
-		}
-	}
-	return false;
-}
-
-bool check_colmap_hit( unsigned int col_map, int col_x, int col_y, bullet_status_t b ) {
-	bool hit = false;
-	if( col_map & 0xf000 ) {
-		hit |= check_enemy_hit( col_x, col_y, b );
-	}
-	if( col_map & 0x0f00 ) {
-		hit |= check_enemy_hit( col_x+1, col_y, b );
 	}
-	if( col_map & 0x00f0 ) {
-		hit |= check_enemy_hit( col_x, col_y+1, b );
-	}
-	if( col_map & 0x000f ) {
-		hit |= check_enemy_hit( col_x+1, col_y+1, b );
-	}
-	return hit;
 }
 
 int wait_start( int delay ) {
@@ -1437,15 +3228,15 @@ bool play_level( int level ){
 					else {
 						set_bullet( current_bullet, BULLET_SMALL );
 					}
+					if( ship.missiles ) {
+						launch_missile();
+					}
 					bullet_charge = 0;
 					update_charge();
 					current_bullet = -1;
 				}
 			}
-			sprites[0].x = ship.x;      sprites[0].y = ship.y;
-			sprites[1].x = ship.x;      sprites[1].y = ship.y + 8;
-			sprites[2].x = ship.x + 8;  sprites[2].y = ship.y + 8;
-			sprites[3].x = ship.x + 16; sprites[3].y = ship.y + 8;
+			meta_move( &ship_meta, ship.x, ship.y );
 			if( buttons & BTN_START ) {
 				while( ReadJoypad(0) != 0 );
 				while( !wait_start(1000) );
@@ -1455,18 +3246,16 @@ bool play_level( int level ){
 		else if( ship.status == STATUS_EXPLODING ) {
 			if( ship.anim_step == 16 ) {
 				TriggerFx( SFX_EXP_L, 0xff, true );
-				MapSprite( 0, ship_explosion_map[0] );
+				meta_map( &ship_meta, ship_explosion_map[0], ship_explosion_layout );
 			}
 
 			if( ship.anim_step == 8 ) {
 				TriggerFx( SFX_EXP_L, 0xff, true );
-				MapSprite( 0, ship_explosion_map[1] );
+				meta_map( &ship_meta, ship_explosion_map[1], ship_explosion_layout );
 			}
 			
 			if( ship.anim_step == 0 ) {
-				for( i=0 ; i<SPRITE_BULLET1 ; i++ ) {
-					sprites[i].tileIndex = 0;
-				}
+				meta_hide( &ship_meta );
 				alive = false;
 				lives--;
 			}
@@ -1478,34 +3267,44 @@ bool play_level( int level ){
 
 		}
 
-		// Collison detection
-		for( i=0 ; i<MAX_SPRITES ; i++ ) {
+		// Collison detection, aliens do their own.
+		col_scroll_x = Screen.scrollX;
+		col_map = meta_check( &ship_meta, &col_x, &col_y );
+		if( col_map && check_meta_hit( col_map, col_x, col_y, BULLET_FREE ) ) {
+			// Ship has crashed
+			crash_ship();
+		}
+		for( i=SPRITE_BULLET1 ; i<SPRITE_BULLET1+MAX_BULLETS ; i++ ) {
 			if( sprites[i].tileIndex ) {
-				col_map = col_check( i, &col_x, &col_y );
+				if( bullet[i-SPRITE_BULLET1].status != BULLET_CHARGING ) {
+					// Fired bullets are tested all along their path.
+					col_map = col_sweep( i, BULLET_SPEED, &col_x, &col_y );
+				}
+				else {
+					col_map = col_check( i, &col_x, &col_y );
+				}
 				if( col_map ) {
-					if( i<SPRITE_BULLET1 ) {
-						if( check_colmap_hit( col_map, col_x, col_y, BULLET_FREE ) ) {
-							// Ship has crashed
-							if( ship.status != STATUS_EXPLODING ) {
-								ship.status = STATUS_EXPLODING;
-								ship.anim_step = 16;
-								sprites[3].x -= 8;
-								sprites[3].y -= 8;
-							}
-						}
-					}
-					else if( i < SPRITE_BULLET1+MAX_BULLETS ) {
-						// Bullet hit something...
-						check_colmap_hit( col_map, col_x, col_y, bullet[i-SPRITE_BULLET1].status );
-						set_bullet( i-SPRITE_BULLET1, BULLET_FREE );
-					}
-					else if( i < SPRITE_WHOOSH+WHOOSH_SPRITES ) {
-						// Same as bullet, but don't erase the whoosh.
-						check_colmap_hit( col_map, col_x, col_y, BULLET_LARGE );
-					}
+					// Bullet hit something...
+					check_colmap_hit( col_map, col_x, col_y, bullet[i-SPRITE_BULLET1].status );
+					set_bullet( i-SPRITE_BULLET1, BULLET_FREE );
 				}
 			}
+			else {
+				// Don't trust the cache once vram_gen has had time to wrap.
+				col_cache[i-SPRITE_BULLET1].tile = 0;
+			}
 		}
+		col_map = meta_check( &whoosh_meta, &col_x, &col_y );
+		if( col_map ) {
+			// Same as bullet, but don't erase the whoosh.
+			check_meta_hit( col_map, col_x, col_y, BULLET_LARGE );
+		}
+
+		update_aliens();
+		update_missiles();
+		update_shots();
+		update_debris();
+		update_bomb();
 
 		if( score != old_score ) {
 			update_score();
@@ -1513,6 +3312,8 @@ bool play_level( int level ){
 		}
 
 		update_enemies();
+		update_anim_tiles();
+		mux_update();
 
 		if( scroll_speed == 0 && boss_enemies == 0 ) {
 			complete = true;
@@ -1525,6 +3326,7 @@ bool play_level( int level ){
 	WaitVsync(60);
 	FadeOut(FADE_SPEED,true);
 	SetSpriteVisibility(false);
+	vram_sync();
 	ClearVram();
 
 	return complete;
@@ -1534,16 +3336,16 @@ void draw_starfield( void ) {
 	int i;
 
 	for( i=0 ; i<30 ; i++ ) {
-		SetTile(
+		put_tile(
 			random()%SCREEN_TILES_H,
 			random()%SCREEN_TILES_V,
-			pgm_read_byte(&random_tiles[(int)level][random()%3])
+			pgm_read_byte(&random_tiles[(int)level][random()%3]) + RAM_TILES_COUNT
 		);
 	}
 	if( level == 4 ) {
 		// Draw in "lava".
 		for( i=0 ; i<VRAM_TILES_H ; i++ ) {
-			SetTile( i, VRAM_TILES_V-1, 112 );
+			put_tile( i, VRAM_TILES_V-1, ANIM_LAVA );	// RAM tile, so no offset
 		}
 	}
 }
@@ -1552,13 +3354,19 @@ void level_intro( int level ) {
 	int i;
 
 	FadeOut(0,true);
+	vram_sync();
 	ClearVram();
+	clear_plane();
 
 	bullet_charge = 0;
 	frame = 0;
 	clear_enemies();
 	enemy_pos = (enemy_def_t*)pgm_read_word(&enemy_data[level-1]);
 	clear_sprites();
+	clear_aliens();
+	clear_missiles();
+	clear_shots();
+	clear_debris();
 	SetTileTable(tiles1);
 	SetSpriteVisibility(true);
 	SetScrolling(0,0);
@@ -1566,24 +3374,22 @@ void level_intro( int level ) {
 	scroll_speed = 5;
 	next_power_up = 3 + random()%3;
 
-	if( level == 4 ) {
-		MapSprite( SPRITE_SHIP, ship_map[1] );
-	}
-	else {
-		MapSprite( SPRITE_SHIP, ship_map[0] );
-	}
-
 	ship.x = -24;
 	ship.y = SHIP_MAX_Y/2;
 	ship.speed = 1;
+	ship.missiles = 0;
 	ship.status = STATUS_OK;
 
-	sprites[0].x = ship.x;      sprites[0].y = ship.y;
-	sprites[1].x = ship.x;      sprites[1].y = ship.y + 8;
-	sprites[2].x = ship.x + 8;  sprites[2].y = ship.y + 8;
-	sprites[3].x = ship.x + 16; sprites[3].y = ship.y + 8;
+	meta_move( &ship_meta, ship.x, ship.y );
+	if( level == 4 ) {
+		meta_map( &ship_meta, ship_map[1], ship_layout );
+	}
+	else {
+		meta_map( &ship_meta, ship_map[0], ship_layout );
+	}
 
 	set_tiles( level );
+	init_anim_tiles();
 	draw_starfield();
 	init_overlay();
 
@@ -1620,10 +3426,7 @@ void level_intro( int level ) {
 
 		if( i > 240 ) {
 			ship.x++;
-			sprites[0].x = ship.x;
-			sprites[1].x = ship.x;
-			sprites[2].x = ship.x + 8;
-			sprites[3].x = ship.x + 16;
+			meta_move( &ship_meta, ship.x, ship.y );
 			if( i%scroll_speed == 0 ) Scroll(1,0);
 			WaitVsync(1);
 		}
@@ -1645,6 +3448,9 @@ void level_intro( int level ) {
 	level_pos = (unsigned char *)pgm_read_word(&level_data[level-1]);
 	level_vram_column = ((Screen.scrollX/8) + VRAM_TILES_H)%VRAM_TILES_H;
 	level_column = 0;
+	// Columns are drawn just as they scroll off the left, ready to come
+	// round on the right, so the whole screen is still before the level.
+	camera_column = -VRAM_TILES_H;
 	level_col_repeat = 0;
 	level_prev_column = NULL;
 }
@@ -1665,7 +3471,7 @@ int show_title() {
 		text_write((SCREEN_TILES_H-10)/2,19,"PUSH START",false);
 		if(( j = wait_start(FPS/2) )) return j;
 
-		fill_tiles((SCREEN_TILES_H-10)/2,19,10,1,0);
+		Fill((SCREEN_TILES_H-10)/2,19,10,1,0);
 		if(( j = wait_start(FPS/2) )) return j;
 	}
 	return 0;
@@ -1829,6 +3635,10 @@ int show_attract() {
 		SetTile(i,POWER_UP_OFFSET+2,overlay_offset+52);
 	}
 
+	// Not scrolling, so level columns are just vram columns.
+	level_column = 0;
+	level_vram_column = 0;
+	camera_column = 0;
 	clear_enemies();
 	for( i=0 ; i<4 ; i++ ) {
 		add_enemy( POWER_UP_SPEED+i, 6, POWER_UP_OFFSET+4+(i*5) );
@@ -1849,6 +3659,7 @@ int main(){
 	int r;
 
 	InitMusicPlayer(patches);
+	SetUserPreVsyncCallback( &vram_flush );
 	while(1) {
 		Screen.overlayHeight=0;
 		SetScrolling(0,0);